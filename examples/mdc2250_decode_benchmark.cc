@@ -0,0 +1,85 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "mdc2250/mdc2250_clock.h"
+#include "mdc2250/mdc2250_decoder.h"
+using namespace mdc2250;
+
+// Counts the decoded frames so the decoder can not be optimized away
+struct CountingHandler : DecoderHandler {
+    unsigned long queries, acks, echoes, errors;
+    CountingHandler() : queries(0), acks(0), echoes(0), errors(0) {}
+
+    void onQuery(const mdc2250_raw_status &status, RuntimeQuery::runtimeQuery query,
+                 const long *values, int count) { queries++; }
+    void onAck(bool accepted) { acks++; }
+    void onEcho(const char *begin, const char *end) { echoes++; }
+    void onError(const char *reason, const char *begin, const char *end) { errors++; }
+};
+
+// The decoder without the block scanner, as built without SSE2
+size_t decodeScalar(const char *data, size_t length, mdc2250_raw_status &status,
+                    CountingHandler &handler) {
+    const char *end=data+length;
+    const char *frame=data;
+    while (frame<end) {
+        const char *stop=static_cast<const char*>(std::memchr(frame,'\r',end-frame));
+        if (stop==NULL)
+            break;
+        decoder::decodeScanned(frame,stop,decoder::isEcho(frame,stop),status,handler);
+        frame=stop+1;
+    }
+    return frame-data;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size=(argc>1) ? std::atol(argv[1])*1024 : 8*1024;
+    int iterations=(argc>2) ? std::atoi(argv[2]) : 20000;
+    if ((size==0)||(iterations<=0)) {
+        std::cerr << "Usage: mdc2250_decode_benchmark [buffer KB] [iterations]" << std::endl;
+        return 1;
+    }
+
+    // mixed telemetry as a backlog after a stall: replies, echoes and acks
+    static const char *period[]={"?A\r","A=12:-7\r","?C\r","C=123456:-98765\r",
+        "?V\r","V=245:121:4980\r","?FF\r","FF=0\r","!M 250 -250\r","+\r"};
+    std::string buffer;
+    for (int i=0; buffer.length()<size; i=(i+1)%10)
+        buffer+=period[i];
+
+    mdc2250_raw_status status;
+    std::memset(&status,0,sizeof(status));
+    CountingHandler scanned, scalar;
+    double start=monotonicTime();
+    for (int i=0; i<iterations; i++)
+        decodeBuffer(buffer.data(),buffer.length(),status,scanned);
+    double scannedTime=monotonicTime()-start;
+    start=monotonicTime();
+    for (int i=0; i<iterations; i++)
+        decodeScalar(buffer.data(),buffer.length(),status,scalar);
+    double scalarTime=monotonicTime()-start;
+
+    if ((scanned.queries!=scalar.queries)||(scanned.acks!=scalar.acks)
+        ||(scanned.echoes!=scalar.echoes)||(scanned.errors!=scalar.errors)) {
+        std::cerr << "Decoders disagree." << std::endl;
+        return 1;
+    }
+
+    double megabytes=buffer.length()*(double)iterations/1.0e6;
+#if defined(MDC2250_SCAN_AVX2_DISPATCH)
+    const char *scanner=scan::hasAvx2() ? "AVX2" : "SSE2";
+#elif defined(__AVX2__)
+    const char *scanner="AVX2";
+#elif defined(MDC2250_SCAN_SIMD)
+    const char *scanner="SSE2";
+#else
+    const char *scanner="none";
+#endif
+    std::cout << "Buffer: " << buffer.length() << " bytes, " << iterations << " iterations" << std::endl;
+    std::cout << "decodeBuffer (" << scanner << "): " << megabytes/scannedTime << " MB/s" << std::endl;
+    std::cout << "memchr loop: " << megabytes/scalarTime << " MB/s" << std::endl;
+    return 0;
+}
@@ -41,56 +41,46 @@
 #define MDC2250_H
 
 // Standard Library Headers
-//#include <map>
+#include <map>
 #include <string>
 //#include <sstream>
 
-// Serial interface library
-#include <serial/serial.h>
-
 // Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
 #include "boost/function.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/shared_mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
 
 // Library Headers
 #include "mdc2250_types.h"
+#include "mdc2250_transport.h"
+#include "mdc2250_link.h"
+#include "mdc2250_odometry.h"
+#include "mdc2250_keepalive.h"
+#include "mdc2250_control_loop.h"
+#include "mdc2250_scheduler.h"
+#include "mdc2250_reflex.h"
+#include "mdc2250_trajectory.h"
+#include "mdc2250_shm.h"
+#include "mdc2250_capture.h"
+#include "mdc2250_clock_sync.h"
+#include "mdc2250_dispatch.h"
+#include "mdc2250_supervisor.h"
+#include "mdc2250_adaptive_telemetry.h"
+#include "mdc2250_trace.h"
+#include "mdc2250_commands.h"
+#include "mdc2250_script.h"
 
 namespace mdc2250 {
 
-//! Structure to represent the current status of the controller
-struct mdc2250_status {
-    int id; //!< motor controller ID - used to differentiate data with multiple controllers
-    double M1_amps; //!< motor 1 current [amps]
-    double M2_amps; //!< motor 2 current [amps]
-    double B1_amps; //!< battery current 1 [amps]
-    double B2_amps; //!< battery current 2 [amps]
-    long E1_count; //!< encoder 1 counts - absolute
-    long E2_count; //!< encoder 2 counts - absolute
-    long E1_rel_count; //!< encoder 1 counts - relative
-    long E2_rel_count; //!< encoder 2 counts - relative
-    long M1_cmd; //!< motor 1 command
-    long M2_cmd; //!< motor 2 command
-    long E1_rpm; //!< encoder speed 1 [rpm]
-    long E2_rpm; //!< encoder speed 2 [rpm]
-    double time; //!< current time
-    double driverVoltage; //!< driver voltage [V]
-    double batVoltage; //!< main battery voltage [V]
-    long fiveVVoltage; //!< 5V output voltage [mV]
-
-    // fault flags
-    bool overheat;
-    bool overvoltage;
-    bool undervoltage;
-    bool shortCircuit;
-    bool ESTOP;
-    bool sepexFault;
-    bool EEPROMFault;
-    bool configFault;
-};
-
 /***** Function Typedefs *****/
 typedef boost::function<void(const std::exception&)> ExceptionCallback;
 typedef boost::function<void(mdc2250_status, RuntimeQuery::runtimeQuery)> RuntimeQueryCallback;
+typedef boost::function<void(const mdc2250_raw_status&, RuntimeQuery::runtimeQuery)> RawQueryCallback;
 typedef boost::function<void(long, long, configitem::ConfigItem)> ConfigCallback;
+typedef boost::function<void(OdometryState)> OdometryCallback;
 
 /*!
  * Represents an MDC2250 Device and provides and interface to it.
@@ -98,9 +88,16 @@ typedef boost::function<void(long, long, configitem::ConfigItem)> ConfigCallback
 class MDC2250 {
 public:
   /*!
-   * Constructs the MDC2250 object.
+   * Constructs the MDC2250 object talking over a serial port.
    */
   MDC2250();
+  /*!
+   * Constructs the MDC2250 object talking over the given transport.
+   *
+   * \param transport byte stream to the controller, e.g. a
+   * LoopbackTransport connected to a simulator
+   */
+  explicit MDC2250(boost::shared_ptr<Transport> transport);
   virtual ~MDC2250();
 
   /*!
@@ -114,6 +111,53 @@ public:
    */
   bool connect(std::string port);
 
+  /*!
+   * Connects to the MDC2250, choosing the line rate from options.
+   *
+   * Each rate in options.baudrates is tried fastest first until the
+   * controller answers the ?TRN handshake; USB CDC ports are opened once
+   * since their rate is ignored.  With options.probe set the link is
+   * measured before continuous reading starts, see getLinkInfo().
+   *
+   * \param port serial port, e.g. "/dev/ttyACM0"
+   * \param options rates to try and probe settings
+   */
+  bool connect(std::string port, const LinkOptions &options);
+
+  //! Returns the line rate, USB detection and probe results of the last connect
+  LinkInfo getLinkInfo() const { return linkInfo; }
+
+  /*!
+   * Starts supervising the connection, call after connect().
+   *
+   * The link counts as lost when a read or write fails or, while a
+   * telemetry plan set with setTelemetryString is active and data has been
+   * flowing, when nothing is received for options.silencePeriods telemetry
+   * periods plus options.silenceMargin.  Without a plan silence is not a
+   * loss, so only failing reads and writes are detected.  The
+   * port is then reopened with backoff, the handshake is repeated and the
+   * session is restored: the telemetry string, encoder PPR, max RPM and
+   * watchdog settings last sent, and continuous reading.  Motor commands
+   * from the keepalive, control loop and trajectory resume by themselves.
+   * Since the controller may have been reset, the odometry takes the next
+   * counter sample as its new baseline, and the digital output shadow and
+   * pending output and variable writes are discarded.
+   *
+   * Commands are not queued across a loss: while the link is being
+   * restored sendCommand refuses them and returns false, and writes that
+   * fail on the lost port are discarded.  Both are counted in
+   * SupervisorStats::dropped, none is retried after the reconnect.
+   *
+   * \param options detection and backoff settings
+   */
+  void enableSupervisor(const SupervisorOptions &options=SupervisorOptions());
+  //! Stops supervising the connection
+  void disableSupervisor();
+  //! Sets the function called with the recovery time [s] after each reconnect
+  void setRecoveryCallback(ConnectionSupervisor::RecoveryCallback callback);
+  //! Returns the number of link losses and the recovery times
+  SupervisorStats getSupervisorStats();
+
   /*!
    * Disconnects from the MDC2250 motor controller given a serial port.
    */
@@ -130,13 +174,63 @@ public:
    */
   void setTelemetryString(std::string queries, long period);
 
+  /*!
+   * Lets the telemetry plan follow the motion of the motors.
+   *
+   * The idle plan is sent at once and the moving plan whenever motorCmd or
+   * multiMotorCmd command a motor or ?S reports it turning, until
+   * options.holdTime passes without motion.  While moving, the period is
+   * lengthened when received data uses more than options.maxLinkUse of the
+   * link measured by connect, or of the line rate without a probe.  Plans
+   * are sent with setTelemetryString, so a reconnect restores the active
+   * one, and they replace any plan set by hand.  The supervisor's silence
+   * timeout follows the period of the active plan.
+   *
+   * \param options plans, motion thresholds and link limit
+   */
+  void enableAdaptiveTelemetry(const AdaptiveTelemetryOptions &options=AdaptiveTelemetryOptions());
+  //! Stops adapting, the active telemetry plan stays in place
+  void disableAdaptiveTelemetry();
+  //! Returns the active plan, link use and switch counts of the adaptive telemetry
+  AdaptiveTelemetryStats getAdaptiveTelemetryStats();
+
   //! Starts reading continously from serial port
   void startContinuousReading();
   //! Stops reading continuously from serial port
   void stopContinuousReading();
 
-  //! Sets the callback function for handling new runtime queries
+  /*!
+   * Sets the callback function for handling new runtime queries.
+   *
+   * The whole status is converted to engineering units for every update
+   * while this callback is set; setRawQueryCallback avoids that.
+   */
   void setRuntimeQueryCallback(RuntimeQueryCallback callback);
+  //! Sets the callback receiving the raw status after each runtime query
+  void setRawQueryCallback(RawQueryCallback callback);
+
+  /*!
+   * Adds a subscriber that receives the raw status on its own thread.
+   *
+   * Unlike the callbacks above, which run on the read thread, the read
+   * thread only queues the update for the subscriber; a worker thread
+   * calls the callback.  A slow subscriber therefore cannot delay reading
+   * or other subscribers, it only loses updates according to
+   * options.policy, counted in getSubscriberStats().
+   *
+   * \param callback function called on the subscriber's thread
+   * \param options queue size and overflow policy
+   * \return id for removeQuerySubscriber and getSubscriberStats
+   */
+  int addRawQuerySubscriber(RawQueryCallback callback,
+                            const SubscriberOptions &options=SubscriberOptions());
+  //! Like addRawQuerySubscriber, converting to mdc2250_status on the subscriber's thread
+  int addQuerySubscriber(RuntimeQueryCallback callback,
+                         const SubscriberOptions &options=SubscriberOptions());
+  //! Stops and removes a subscriber
+  void removeQuerySubscriber(int id);
+  //! Returns the delivered and dropped counts of a subscriber
+  SubscriberStats getSubscriberStats(int id);
 
   //! Clears the query history and stops sending queries
   void clearBufferHistory();
@@ -147,45 +241,411 @@ public:
    */
   void sendQueryHistory(long period);
 
+  /*!
+   * Sets the acceleration used by the closed loop modes (!AC).
+   *
+   * \param channel motor channel (1 or 2)
+   * \param acceleration acceleration [0.1 RPM/s]
+   */
   void setAcceleration(int channel, int acceleration);
   void getAcceleration(int channel, int acceleration);
 
   void ESTOP();
   void ClearESTOP();
-  void motorCmd(int channel, int command);
-  void multiMotorCmd(int cmd1, int cmd2);
-  void setPosition(int channel, int position);
-  void setVelocity(int channel, int velocity);
-  void setEncoderCounter(int channel, int value);
+  //! Commands one motor (!G), false if the command was refused
+  bool motorCmd(int channel, int command);
+  /*!
+   * Commands both motors with a single !M command.
+   *
+   * While the control loop is running the setpoint is handed to the loop
+   * thread instead of being written immediately.
+   *
+   * \return false if the command was refused, see sendCommand
+   */
+  bool multiMotorCmd(int cmd1, int cmd2);
+  //! Sends a closed loop position setpoint [counts] (!P), false if refused
+  bool setPosition(int channel, int position);
+  //! Sends a closed loop speed setpoint [RPM] (!S), false if refused
+  bool setVelocity(int channel, int velocity);
+  /*!
+   * Loads the encoder counter of a channel (!C).
+   *
+   * The odometry takes its new baseline when the controller echoes the
+   * command, so samples still in flight are not mistaken for the loaded
+   * value; leave the echo enabled (^ECHOF 0) when using odometry.
+   *
+   * \return false if the command was refused, see sendCommand
+   */
+  bool setEncoderCounter(int channel, int value);
+
+  /*!
+   * Sends any command of the command set.
+   *
+   * Motor commands take the same path as motorCmd, multiMotorCmd,
+   * setPosition and setVelocity.  Digital output and user variable writes
+   * go through the batch of setDigitalOutput and setUserVariable, which is
+   * flushed right away.
+   *
+   * Example: sendCommand(commanditem::_DECEL, 1, 5000);
+   *
+   * \param item command to send
+   * \param arg1 first argument, usually the channel, see commandArguments
+   * \param arg2 second argument, usually the value
+   * \return false if the item is unknown or the command was not sent
+   */
+  bool sendCommand(commanditem::CommandItem item, long arg1=0, long arg2=0);
+
+  /*!
+   * Sets or resets a digital output at the next flush.
+   *
+   * Output changes are collected until flushCommands() runs, which the
+   * control loop does once per period while it is running.  A flush writes
+   * all outputs with a single !DS once the output register is known from
+   * setDigitalOutputs or a ?DO response, otherwise one frame of !D1/!D0.
+   *
+   * \param output output number (1 to 8)
+   * \param state true to set the output
+   * \return false if the output number is out of range
+   */
+  bool setDigitalOutput(int output, bool state);
+  //! Sets all digital outputs at the next flush, bit 0 is output 1
+  void setDigitalOutputs(int mask);
+  //! Returns the digital outputs as last written or read, pending changes included
+  int getDigitalOutputs();
+  //! Sets a user variable (!VAR) at the next flush, the latest value per variable wins
+  void setUserVariable(int index, long value);
+  /*!
+   * Sends the pending digital output and user variable writes as one frame.
+   *
+   * \return false if the frame was refused, e.g. while the link is being
+   * restored; the writes then stay pending for the next flush
+   */
+  bool flushCommands();
+
+  /*!
+   * Uploads a compiled MicroBasic script to the controller.
+   *
+   * The running script is stopped, the controller is put in script load
+   * mode (%SLD) and the records are sent one at a time, each waiting for
+   * the controller's acknowledgement.  Continuous reading must be running
+   * so the acknowledgements are seen.  Acknowledgements are matched by
+   * count, so the control loop, trajectory, watchdog keepalive and
+   * adaptive telemetry must be stopped, and other commands, e.g. motorCmd,
+   * are refused until the upload returns.  Commands sent before are
+   * written and their acknowledgements awaited before the script is
+   * stopped.  A safety command sent meanwhile
+   * still goes out and makes the upload fail.  The script is not started.
+   *
+   * \param path Intel HEX file compiled by Roborun+, see loadScriptHex
+   * \return false if the file is invalid or a record was not acknowledged
+   */
+  bool uploadScript(const std::string &path);
+  //! Uploads the records of a compiled script, see uploadScript(const std::string&)
+  bool uploadScript(const std::vector<std::string> &records);
+  /*!
+   * Starts or resumes the MicroBasic script (!R).
+   *
+   * Pass parameters to the script with setUserVariable and flushCommands
+   * before or while it runs; it reads them with getvalue(_VAR, n).
+   *
+   * \param restart restart from the beginning with the variables reset
+   */
+  void startScript(bool restart=false);
+  //! Stops the MicroBasic script (!R 0)
+  void stopScript();
+  /*!
+   * Asks for the value of a user variable (?VAR).
+   *
+   * The answer arrives on the read thread as a RuntimeQuery::_VAR update
+   * and is then available from getUserVariable.  "?VAR" without an index
+   * in the telemetry string reports the first variables every period.
+   *
+   * \param index user variable number, starting at 1
+   */
+  void requestUserVariable(int index);
+  /*!
+   * Returns the last value received for a user variable.
+   *
+   * \param index user variable number, starting at 1
+   * \param value receives the value
+   * \return false if no value was received for the variable yet
+   */
+  bool getUserVariable(int index, long &value);
+
+  /*!
+   * Starts streaming trajectory setpoints.
+   *
+   * Profiles appended with appendTrajectory are sampled by a dedicated
+   * thread at a fixed period and sent as !P or !S setpoints, so long moves
+   * do not depend on the application thread.  Trajectory time zero is the
+   * time of this call.
+   *
+   * \param options streaming period, lookahead and setpoint mode
+   */
+  void startTrajectory(const TrajectoryOptions &options);
+  /*!
+   * Appends points to the trajectory of a channel.
+   *
+   * \param channel motor channel (1 or 2)
+   * \param points points with increasing times [s], positions [counts]
+   * and velocities [counts/s]
+   * \return false if the points were rejected
+   */
+  bool appendTrajectory(int channel, const std::vector<TrajectoryPoint> &points);
+  //! Marks the trajectory of a channel as complete
+  void endTrajectory(int channel);
+  //! Returns true when all trajectories have been streamed completely
+  bool isTrajectoryDone();
+  //! Stops streaming trajectory setpoints
+  void stopTrajectory();
+  //! Returns the throughput and timing error of the trajectory streamer
+  TrajectoryStats getTrajectoryStats();
 
   void reset();
   void factoryReset();
   void saveEEPROM();
 
+  /*!
+   * Sets the RS232 watchdog (^RWD) and starts the keepalive.
+   *
+   * The controller stops the motors if no command arrives within the
+   * watchdog period.  The keepalive resends the last motor command well
+   * before that happens whenever the application has been quiet.
+   *
+   * \param ms watchdog period [ms], 0 disables the watchdog
+   */
   void setWatchdogTimer(long ms);
+  /*!
+   * Sets the RS232 watchdog (^RWD) and starts the keepalive.
+   *
+   * \param ms watchdog period [ms], 0 disables the watchdog
+   * \param options resend margin and keepalive thread scheduling
+   */
+  void setWatchdogTimer(long ms, const KeepaliveOptions &options);
+  //! Returns the wake up jitter and near miss counts of the keepalive
+  KeepaliveStats getKeepaliveStats();
+
+  /*!
+   * Starts the fixed rate control loop.
+   *
+   * While running, multiMotorCmd only publishes its setpoint and the loop
+   * thread sends one !M command per period with the latest setpoint.
+   *
+   * \param options loop period and thread scheduling
+   */
+  void startControlLoop(const ControlLoopOptions &options);
+  //! Stops the control loop, multiMotorCmd writes directly again
+  void stopControlLoop();
+  //! Returns the overrun and setpoint age statistics of the control loop
+  ControlLoopStats getControlLoopStats();
   void setEncoderPPR(int channel, int ppr);
   long getEncoderPPR();
   void setMaxRPM(int channel, int mrpm);
   long getMaxRPM();
+  //! Clears both encoder counters, the odometry follows as for setEncoderCounter
   void ClearEncoderCounts();
 
+  /*!
+   * Enables the built in odometry estimator.
+   *
+   * The estimator is updated on the read thread from every ?C or ?CR
+   * response, so one of those queries must be part of the telemetry string.
+   * Encoder resolution is taken from setEncoderPPR.
+   *
+   * \param config wheel geometry and velocity filter settings
+   * \return false if wheelRadius or trackWidth is not positive
+   */
+  bool enableOdometry(const OdometryConfig &config);
+  //! Stops updating the odometry estimate
+  void disableOdometry();
+  //! Clears the odometry pose, wheel positions and velocities
+  void resetOdometry();
+  //! Returns the latest odometry estimate
+  OdometryState getOdometry();
+  /*!
+   * Publishes every status update to a shared memory segment.
+   *
+   * Other local processes can follow the status with a TelemetryReader
+   * opened on the same name without going through this process.
+   *
+   * \param name segment name, e.g. "/mdc2250" for /dev/shm/mdc2250
+   * \param history number of recent updates kept in the segment
+   * \return false if the segment could not be created
+   */
+  bool enableTelemetryPublisher(std::string name, size_t history=256);
+  //! Stops publishing and removes the shared memory segment
+  void disableTelemetryPublisher();
+  /*!
+   * Records everything read from the controller to a capture file.
+   *
+   * The reads are stored as they arrive with their arrival times, so a
+   * session can be decoded again later or converted to a column file
+   * with the mdc2250_export tool.
+   *
+   * \param path capture file, replaced if it exists
+   * \return false if the file could not be created
+   */
+  bool enableCapture(std::string path);
+  //! Stops recording and closes the capture file
+  void disableCapture();
+  /*!
+   * Starts estimating the controller clock from ?TM responses.
+   *
+   * Add "?TM" to the telemetry string so every period carries the
+   * controller time.  Once the estimate is valid, status.time holds the
+   * controller time of each update instead of its host arrival time, so
+   * updates from several controllers can be lined up with
+   * ClockSyncState::offset and drift.  Unless options.maxTickGap is set,
+   * the gap allowed between responses follows the period given to
+   * setTelemetryString.
+   *
+   * \param options fit window and tick gap settings
+   */
+  void enableClockSync(const ClockSyncOptions &options=ClockSyncOptions());
+  //! Stops the clock estimate, status.time reverts to host arrival time
+  void disableClockSync();
+  //! Returns the offset and drift of the controller clock
+  ClockSyncState getClockSyncState();
+
+  //! Sets the callback function called after each odometry update
+  void setOdometryCallback(OdometryCallback callback);
+
+  /*!
+   * Sends a command, choosing its priority class from its prefix.
+   *
+   * \see sendCommand(std::string, commandpriority::CommandPriority)
+   */
   bool sendCommand(std::string cmd);
+  /*!
+   * Sends a command with the given priority class.
+   *
+   * While connected, commands other than safety commands are queued and
+   * written by the scheduler thread in the order they were sent.  Safety
+   * commands are written from the calling thread ahead of anything queued;
+   * an emergency stop (!EX) also discards the queued motion commands.
+   *
+   * \param cmd raw command string including the trailing '\r'
+   * \param priority priority class of the command
+   * \return true if the command was written, or queued for writing while
+   * connected; a queued command whose write fails later is counted in
+   * SchedulerStats::writeErrors.  false if the write failed or the command
+   * was refused because the link is being restored or uploadScript runs
+   * (safety commands are never refused by uploadScript).
+   */
+  bool sendCommand(std::string cmd, commandpriority::CommandPriority priority);
+  /*!
+   * Adds a rule reacting to fault flag transitions.
+   *
+   * Rules are evaluated on the read thread whenever a ?FF response is
+   * parsed, before the runtime query callback runs, and their commands are
+   * written through the safety lane from that thread.  Every action first
+   * discards the queued motion commands, so none of them drives the motors
+   * again after the reaction.  ?FF must be part of
+   * the telemetry string for the rules to see the faults.
+   *
+   * Example: addFaultRule(FaultRule(faultflag::_SHORTCIRCUIT, faultaction::_ESTOP));
+   *
+   * \return index of the rule, or -1 if the rule table is full
+   */
+  int addFaultRule(const FaultRule &rule);
+  //! Removes all fault rules
+  void clearFaultRules();
+  //! Returns the fault to command latency of the fault rules
+  ReflexStats getReflexStats();
+
+  //! Sets the batching and thread options used by the scheduler from the next connect
+  void setSchedulerOptions(const SchedulerOptions &options);
+  //! Returns the write counts and safety command latency of the scheduler
+  SchedulerStats getSchedulerStats();
 
 private:
-    serial::Serial my_port;  //!< serial port for communicating with the motor controller
+    //! sets up callbacks and status, shared by the constructors
+    void init();
+    boost::shared_ptr<Transport> transport; //!< byte stream to the motor controller
+    //! writes raw bytes to the port, called by the scheduler
+    bool writePort(const std::string &data);
+    CommandScheduler scheduler; //!< prioritized writer used for all commands
+    SchedulerOptions schedulerOptions;
+    //! checks that a Roboteq controller answers ?TRN and returns its model
+    bool handshake(std::string &model);
+    LinkInfo linkInfo; //!< link chosen by the last connect
+    std::string portName; //!< port given to the last connect
+
+    //! reopens the port and restores the session, called by the supervisor
+    bool reconnectLink();
+    ConnectionSupervisor supervisor; //!< reconnects when the link is lost
+    boost::shared_mutex sendMutex; //!< shared by senders, taken by reconnectLink
+    SessionState session; //!< settings replayed after a reconnect
+    boost::mutex sessionMutex; //!< guards session
+
+    //! sends a plan chosen by adaptiveTelemetry
+    void applyTelemetryProfile(const TelemetryProfile &profile);
+    AdaptiveTelemetry adaptiveTelemetry; //!< switches telemetry plans with motion
+    boost::atomic<bool> adaptiveTelemetryEnabled; //!< read on the read thread
 
     //! data callback for handling serial data
-    void readDataCallback(std::string readData);
-    void parsePacket(std::string packet);
-    std::map<std::string, RuntimeQuery::runtimeQuery> queryMap; //!< map used to parse query data
-    std::map<std::string, configitem::ConfigItem> configMap; //!< map used to parse query data
-    bool waitForAck(); //!< block until a command acknowledgement is received
-    bool ackReceived; //!< true if command acknowledgement has been received
-    // TODO: add mutex and condition variable for ackReceived
-
-    mdc2250_status curStatus;
+    void readDataCallback(const char *data, size_t length);
+    //! reports a failed continuous read to the supervisor
+    void readErrorCallback(const std::string &reason);
+    //! reacts to a decoded query response and calls the query callback
+    void handleQuery(RuntimeQuery::runtimeQuery query, const long *values, int count);
+    struct PacketHandler; //!< adapts the decoder to the callbacks above
+    std::string readCarry; //!< partial packet waiting for its '\r'
+    boost::thread::id readThread; //!< thread of the last read, named in the trace
+    //! sends a command and blocks until it is acknowledged, false on a '-' or timeout
+    bool sendAndWaitForAck(const std::string &cmd, double timeout);
+    //! blocks until no acknowledgement arrived for quiet [s], false after timeout [s]
+    bool waitForAckSilence(double quiet, double timeout);
+    boost::mutex ackMutex; //!< guards ackCount and ackAccepted
+    boost::condition_variable ackCondition; //!< notified for every acknowledgement
+    unsigned long ackCount; //!< acknowledgements received so far
+    bool ackAccepted; //!< the last acknowledgement was a '+'
+    boost::atomic<bool> scriptLoading; //!< script records are being sent
+    boost::atomic<bool> scriptInterrupted; //!< a safety command was sent during the upload
+    //! queues a command past the script upload check of sendCommand
+    bool scheduleCommand(const std::string &cmd, commandpriority::CommandPriority priority,
+                         bool purgeMotion=false);
+
+    //! stores a ?VAR response, on the read thread
+    void updateUserVariables(const long *values, int count);
+    int lastVariableQuery; //!< index of the last echoed ?VAR, 0 for all variables
+    std::map<int,long> userVariables; //!< last value of each user variable
+    boost::mutex variableMutex; //!< guards userVariables
+
+    mdc2250_raw_status curStatus;
+    double lastReadTime; //!< monotonic arrival time of the data being parsed [s]
     RuntimeQueryCallback queryCallback;
+    RawQueryCallback rawQueryCallback;
+    QueryDispatcher dispatcher; //!< off thread delivery to subscribers
     ConfigCallback configCallback;
+
+    //! feeds an encoder sample to the odometry estimator and calls back
+    void updateOdometry(bool absolute, long value1, long value2);
+    OdometryEstimator odometry; //!< encoder odometry, updated on the read thread
+    boost::atomic<bool> odometryEnabled; //!< read on the read thread
+    boost::mutex odometryMutex; //!< guards odometry against readers
+    OdometryCallback odometryCallback;
+
+    //! sends !EX and zeroes the setpoints that would be resent after !MG
+    bool sendEmergencyStop();
+    //! sends a safety command that stops the motors, discarding queued motion commands
+    bool sendStopCommand(const std::string &cmd);
+    //! sends a motor command and records it for the keepalive if it was accepted
+    bool sendMotorCommand(std::string cmd);
+    WatchdogKeepalive keepalive; //!< resends motor commands to hold off ^RWD
+    ControlLoop controlLoop; //!< fixed rate !M loop fed by multiMotorCmd
+    CommandBatcher batcher; //!< digital output and user variable writes until the next flush
+
+    //! carries out the action of a fired fault rule on the read thread
+    bool executeFaultRule(const FaultRule &rule);
+    FaultReflex reflex; //!< fault flag rules evaluated in handleQuery
+    TrajectoryStreamer trajectory; //!< streams !P/!S setpoints from profiles
+
+    ClockSync clockSync; //!< controller clock estimate from ?TM
+    boost::atomic<bool> clockSyncEnabled; //!< read on the read thread
+    TelemetryPublisher publisher; //!< shared memory export of curStatus
+    boost::mutex publisherMutex; //!< guards publisher against enable/disable
+    CaptureWriter capture; //!< records reads for mdc2250_export
 };
 
 }
@@ -0,0 +1,174 @@
+/*!
+ * \file mdc2250/mdc2250_adaptive_telemetry.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides an adaptive telemetry plan for the Roboteq MDC2250 that
+ * switches the ^TELS queries and period between motion and standstill.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_ADAPTIVE_TELEMETRY_H
+#define MDC2250_ADAPTIVE_TELEMETRY_H
+
+// Standard Library Headers
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_realtime.h"
+
+namespace mdc2250 {
+
+//! A telemetry plan: the queries sent with ^TELS and their period
+struct TelemetryProfile {
+    std::string queries; //!< queries separated by ':', e.g. "?C:?S"
+    long period; //!< time between telemetry frames [ms]
+
+    TelemetryProfile() : period(0) {}
+    TelemetryProfile(const std::string &queries, long period)
+        : queries(queries), period(period) {}
+};
+
+//! Settings of the adaptive telemetry controller
+struct AdaptiveTelemetryOptions {
+    TelemetryProfile moving; //!< plan while the motors are commanded or turning
+    TelemetryProfile idle; //!< plan at standstill
+    int commandThreshold; //!< motor commands above this magnitude count as motion
+    long rpmThreshold; //!< speeds or speed changes above this magnitude count as motion [RPM]
+    double holdTime; //!< stay in the moving plan this long after the last motion [s]
+    double maxLinkUse; //!< fraction of the link the moving plan may use, 0 for no limit
+    double linkWindow; //!< averaging time of the link use, also the least time between period changes [s]
+    double checkPeriod; //!< how often the motion state is evaluated [s]
+
+    AdaptiveTelemetryOptions() : moving("?C:?S:?FF",10),
+        idle("?C:?S:?A:?V:?T:?FF",100), commandThreshold(10),
+        rpmThreshold(5), holdTime(1.0), maxLinkUse(0.5), linkWindow(0.5),
+        checkPeriod(0.02) {}
+};
+
+//! State and switch counts of the adaptive telemetry controller
+struct AdaptiveTelemetryStats {
+    bool moving; //!< the moving plan is active
+    long period; //!< period of the active plan [ms]
+    double linkUse; //!< averaged fraction of the link used for received data
+    unsigned long switches; //!< changes between the idle and moving plans
+    unsigned long throttles; //!< moving period increases caused by link use
+    unsigned long restores; //!< moving period decreases after link use dropped
+};
+
+/*!
+ * Chooses the telemetry plan from the motion state and the link use.
+ *
+ * Motion is seen from the motor commands reported with commandSent() and
+ * from the speeds reported with speedUpdate().  The controller thread
+ * switches to the moving plan as soon as either exceeds its threshold and
+ * back to the idle plan only after holdTime without motion, so short
+ * pauses do not make the plan flap.  Frames at standstill are sparse,
+ * leaving the link to commands and configuration.
+ *
+ * While moving, the bytes reported with bytesReceived() are averaged over
+ * linkWindow.  If they exceed maxLinkUse of the link capacity the period is
+ * doubled, up to the idle period, and it is halved again, down to the
+ * moving period, once the use falls below half of maxLinkUse.
+ *
+ * Every plan change is applied through the apply function, which is
+ * expected to send ^TELS and record the plan for reconnects.
+ */
+class AdaptiveTelemetry {
+public:
+    typedef boost::function<void(const TelemetryProfile&)> ApplyFunction;
+
+    /*!
+     * \param apply function sending a telemetry plan to the controller
+     */
+    AdaptiveTelemetry(ApplyFunction apply);
+    ~AdaptiveTelemetry();
+
+    /*!
+     * Applies the idle plan and starts the controller thread.
+     *
+     * \param options plans, thresholds and link limit
+     * \param linkCapacity bytes per second the link can carry, 0 if unknown
+     */
+    void start(const AdaptiveTelemetryOptions &options, double linkCapacity);
+    //! Stops the controller thread, the active plan stays on the controller
+    void stop();
+    //! Returns true if the controller thread is running
+    bool isRunning();
+
+    //! Records a motor command that was just sent to a channel (1 or 2)
+    void commandSent(int channel, int command);
+    //! Records the motor speeds of a status update [RPM]
+    void speedUpdate(long rpm1, long rpm2);
+    //! Records bytes received from the controller
+    void bytesReceived(size_t count) { received.fetch_add(count,boost::memory_order_relaxed); }
+
+    //! Returns the active plan, empty if the controller never ran
+    TelemetryProfile getProfile();
+    //! Returns the motion state and switch counts since start()
+    AdaptiveTelemetryStats getStats();
+
+private:
+    void run();
+    //! applies the plan for the current state, called with mutex held
+    void applyPlan(double now);
+
+    ApplyFunction apply;
+    boost::scoped_ptr<boost::thread> thread;
+    DeadlineTimer timer;
+    AdaptiveTelemetryOptions options;
+    double linkCapacity; //!< [bytes/s], 0 if unknown
+
+    boost::atomic<int> command[2]; //!< magnitude of the last motor command per channel
+    boost::atomic<long> speed; //!< largest magnitude of the last speeds [RPM]
+    boost::atomic<long> speedChange; //!< largest speed change seen since the last check [RPM]
+    boost::atomic<unsigned long> received; //!< bytes received since the last check
+    long lastSpeed[2]; //!< previous speeds, only touched by speedUpdate
+
+    boost::mutex mutex; //!< guards the members below
+    TelemetryProfile profile; //!< plan last applied
+    double lastMotion; //!< monotonic time motion was last seen [s]
+    double lastChange; //!< monotonic time the plan was last changed [s]
+    long movingPeriod; //!< period of the moving plan after throttling [ms]
+    AdaptiveTelemetryStats stats;
+};
+
+}
+
+#endif
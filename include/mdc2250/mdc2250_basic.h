@@ -0,0 +1,198 @@
+/*!
+ * \file mdc2250/mdc2250_basic.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a header only MDC2250 interface templated on its transport
+ * and handler, so decoding and dispatch compile into one loop.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_BASIC_H
+#define MDC2250_BASIC_H
+
+// Standard Library Headers
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Library Headers
+#include "mdc2250_types.h"
+#include "mdc2250_decoder.h"
+
+namespace mdc2250 {
+
+/*!
+ * Lean MDC2250 interface with compile time dispatch.
+ *
+ * TransportType is held by value and needs open(port), close(), isOpen(),
+ * setBaudrate(rate), setTimeoutMilliseconds(ms), read(size) returning a
+ * std::string and write(std::string) returning the bytes written; every
+ * class in mdc2250_transport.h qualifies.  Handler receives the decoded
+ * frames as described by DecoderHandler.  Because both types are known to
+ * the compiler, poll() and feed() inline the decoder and the handler into
+ * a single loop without virtual or boost::function calls.
+ *
+ * Unlike MDC2250 this class starts no threads: the application calls
+ * poll() from its own loop.  It is not thread safe.
+ */
+template <class TransportType, class Handler>
+class BasicMDC2250 {
+public:
+  /*!
+   * \param handler receives the decoded frames, must outlive this object
+   */
+  explicit BasicMDC2250(Handler &handler) : handler(handler) {
+    std::memset(&curStatus,0,sizeof(curStatus));
+  }
+
+  //! Returns the transport, e.g. to connect a loopback peer
+  TransportType& getTransport() { return transport; }
+  //! Returns the status decoded so far, see mdc2250_raw_status::toStatus
+  const mdc2250_raw_status& getStatus() const { return curStatus; }
+
+  /*!
+   * Opens the transport and checks that an MDC2250 answers.
+   *
+   * \param port port name passed to the transport
+   * \param baudrate line rate for transports that have one
+   */
+  bool connect(const std::string &port, unsigned long baudrate=115200) {
+    try {
+      transport.setBaudrate(baudrate);
+      transport.open(port);
+      if (!transport.isOpen())
+        return false;
+      transport.setTimeoutMilliseconds(50);
+      // stop any query history and flush what is already buffered
+      transport.write("# C\r");
+      transport.read(10000);
+      transport.write("\r?TRN\r");
+      std::string result=transport.read(64);
+      if (result.find("MDC2250")==std::string::npos) {
+        std::cout << "Roboteq MDC2250 not found." << std::endl;
+        transport.close();
+        return false;
+      }
+      transport.setTimeoutMilliseconds(25);
+    } catch (std::exception &e) {
+      std::cout << "Failed to connect to MDC2250: " << e.what() << std::endl;
+      return false;
+    }
+    carry.clear();
+    return true;
+  }
+
+  //! Closes the transport
+  void disconnect() {
+    transport.close();
+  }
+
+  //! Writes a raw command, returning true if all of it was written
+  bool sendCommand(const std::string &cmd) {
+    try {
+      return transport.write(cmd)==cmd.length();
+    } catch (std::exception &e) {
+      std::cout << "Failed to send command: " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+  void motorCmd(int channel, int command) {
+    std::stringstream cmd;
+    cmd << "!G " << channel << " " << command << "\r";
+    sendCommand(cmd.str());
+  }
+
+  void multiMotorCmd(int cmd1, int cmd2) {
+    std::stringstream cmd;
+    cmd << "!M " << cmd1 << " " << cmd2 << "\r";
+    sendCommand(cmd.str());
+  }
+
+  void ESTOP() {
+    sendCommand("!EX\r");
+  }
+
+  void ClearESTOP() {
+    sendCommand("!MG\r");
+  }
+
+  /*!
+   * Reads what the transport has (waiting at most its timeout) and decodes it.
+   *
+   * \param maxBytes largest number of bytes to read
+   * \return number of bytes read
+   */
+  size_t poll(size_t maxBytes=4096) {
+    std::string data=transport.read(maxBytes);
+    feed(data.data(),data.length());
+    return data.length();
+  }
+
+  /*!
+   * Decodes controller output, keeping a trailing partial frame for the
+   * next call.
+   */
+  void feed(const char *data, size_t length) {
+    if (!carry.empty()) {
+      // complete the frame left over from the previous call first
+      const char *stop=static_cast<const char*>(std::memchr(data,'\r',length));
+      if (stop==NULL) {
+        carry.append(data,length);
+        return;
+      }
+      carry.append(data,stop-data+1);
+      decodeBuffer(carry.data(),carry.length(),curStatus,handler);
+      carry.clear();
+      length-=stop-data+1;
+      data=stop+1;
+    }
+    size_t consumed=decodeBuffer(data,length,curStatus,handler);
+    carry.assign(data+consumed,length-consumed);
+  }
+
+private:
+  // Disable copies
+  BasicMDC2250(const BasicMDC2250&);
+  BasicMDC2250& operator=(const BasicMDC2250&);
+
+  TransportType transport;
+  Handler &handler;
+  mdc2250_raw_status curStatus;
+  std::string carry; //!< partial frame waiting for its '\r'
+};
+
+}
+
+#endif
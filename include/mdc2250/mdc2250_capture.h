@@ -0,0 +1,128 @@
+/*!
+ * \file mdc2250/mdc2250_capture.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a binary capture format recording the raw serial data read
+ * from a Roboteq MDC2250 together with its arrival times.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_CAPTURE_H
+#define MDC2250_CAPTURE_H
+
+// Standard Library Headers
+#include <fstream>
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/cstdint.hpp"
+#include "boost/thread/mutex.hpp"
+
+namespace mdc2250 {
+
+static const boost::uint32_t CAPTURE_MAGIC = 0x4d444343; //!< "MDCC"
+static const boost::uint32_t CAPTURE_VERSION = 1; //!< layout version of capture files
+
+/*!
+ * Start of a capture file.
+ *
+ * Record times are monotonic; wallStart and monotonicStart, taken at the
+ * same moment, map them to wall clock time.  All values are stored in
+ * host byte order.
+ */
+struct CaptureHeader {
+    boost::uint32_t magic; //!< CAPTURE_MAGIC
+    boost::uint32_t version; //!< CAPTURE_VERSION
+    boost::int64_t wallStart; //!< wall clock time the capture started [us since 1970]
+    boost::int64_t monotonicStart; //!< monotonic time the capture started [us]
+};
+
+//! Precedes the bytes of each read in a capture file
+struct CaptureRecord {
+    boost::int64_t time; //!< monotonic arrival time of the read [us]
+    boost::uint32_t length; //!< number of bytes following the record
+    boost::uint32_t reserved; //!< zero
+};
+
+/*!
+ * Records every read from the controller to a capture file.
+ *
+ * The bytes are stored exactly as read, so frames may span records.  A
+ * capture can be replayed through the decoder or converted to a column
+ * file with the mdc2250_export tool.
+ */
+class CaptureWriter {
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    /*!
+     * Creates the capture file, replacing an existing one.
+     *
+     * \return false if the file could not be created
+     */
+    bool open(const std::string &path);
+    //! Flushes and closes the file
+    void close();
+    //! Returns true if the file is open
+    bool isOpen();
+
+    /*!
+     * Appends a read to the capture.
+     *
+     * \param time monotonic arrival time of the read [s]
+     * \param data bytes read
+     * \param length number of bytes
+     */
+    void write(double time, const char *data, size_t length);
+
+private:
+    // Disable copies
+    CaptureWriter(const CaptureWriter&);
+    CaptureWriter& operator=(const CaptureWriter&);
+
+    boost::mutex mutex; //!< guards file
+    std::ofstream file;
+};
+
+/*!
+ * Reads the header of a capture file.
+ *
+ * \return false if the stream does not start with a capture header of
+ * this version
+ */
+bool readCaptureHeader(std::istream &input, CaptureHeader &header);
+
+}
+
+#endif
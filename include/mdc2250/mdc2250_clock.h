@@ -0,0 +1,72 @@
+/*!
+ * \file mdc2250/mdc2250_clock.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the monotonic time source used to timestamp samples in the
+ * mdc2250 library.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_CLOCK_H
+#define MDC2250_CLOCK_H
+
+#if defined(_WIN32)
+#include "boost/date_time/posix_time/posix_time.hpp"
+#else
+#include <time.h>
+#endif
+
+namespace mdc2250 {
+
+/*!
+ * Returns the current time of a monotonic clock in seconds.
+ *
+ * The epoch is arbitrary, so only differences between two values are
+ * meaningful.  Unlike the wall clock this never jumps backwards.
+ */
+inline double monotonicTime() {
+#if defined(_WIN32)
+    static const boost::posix_time::ptime epoch =
+        boost::posix_time::microsec_clock::universal_time();
+    return (boost::posix_time::microsec_clock::universal_time() - epoch)
+        .total_microseconds() / 1.0e6;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+#endif
+}
+
+}
+
+#endif
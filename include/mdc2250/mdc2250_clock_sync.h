@@ -0,0 +1,149 @@
+/*!
+ * \file mdc2250/mdc2250_clock_sync.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the estimate of the controller clock from ?TM responses,
+ * used to stamp telemetry with controller time.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_CLOCK_SYNC_H
+#define MDC2250_CLOCK_SYNC_H
+
+// Standard Library Headers
+#include <deque>
+
+// Boost Headers (system or from vender/*)
+#include "boost/thread/mutex.hpp"
+
+namespace mdc2250 {
+
+//! Settings of the controller clock estimate
+struct ClockSyncOptions {
+    int window; //!< number of clock ticks kept for the fit
+    /*!
+     * Ignore ticks seen after a gap between responses longer than this [s].
+     * 0 derives it from the telemetry period: 1.5 periods, so one late
+     * response is tolerated, plus 1 s, the resolution of ?TM; 2 s while
+     * the period is unknown.
+     */
+    double maxTickGap;
+
+    ClockSyncOptions() : window(128), maxTickGap(0) {}
+};
+
+//! Current controller clock estimate
+struct ClockSyncState {
+    bool valid; //!< true once enough ticks have been seen to fit
+    int ticks; //!< ticks in the window
+    double offset; //!< host time at controller time zero [s]
+    double drift; //!< host seconds per controller second, minus one
+    double jitter; //!< mean lag of the ticks behind the fitted line [s]
+
+    ClockSyncState() : valid(false), ticks(0), offset(0.0), drift(0.0),
+        jitter(0.0) {}
+};
+
+/*!
+ * Estimates the controller clock from ?TM responses.
+ *
+ * The controller reports time in whole seconds, so single responses say
+ * little.  Instead the moment the count changes is used: the tick happened
+ * between the previous response and this one, and this response arrived
+ * no earlier than the tick plus the transfer delay.  With ?TM in the
+ * telemetry string the previous response is only one period old, so
+ * each tick is pinned down to within one period plus the delay, and
+ * ticks that happen to see the least delay lie on the lower envelope of
+ * (controller seconds, host arrival time).
+ *
+ * The fit is the edge of the lower convex hull of the ticks in the window
+ * that passes highest at their mean: no tick arrived before it and it
+ * rests on the least delayed ones.  Its slope is the drift between the
+ * clocks.  The delay that every response sees is indistinguishable from
+ * offset and stays in it.  Methods are thread safe.
+ */
+class ClockSync {
+public:
+  explicit ClockSync(const ClockSyncOptions &options=ClockSyncOptions());
+
+  //! Changes the settings and discards the estimate
+  void setOptions(const ClockSyncOptions &options);
+  //! Discards the estimate, e.g. after the controller restarted
+  void reset();
+  //! Sets the period ?TM responses arrive with [s], 0 if unknown
+  void setTelemetryPeriod(double period);
+
+  /*!
+   * Feeds a ?TM response.
+   *
+   * \param seconds controller time from the response
+   * \param hostTime monotonic arrival time of the response [s]
+   * \return true if the response showed a clock tick
+   */
+  bool update(long seconds, double hostTime);
+
+  //! Returns true once the estimate can be used
+  bool isValid();
+  //! Converts a host monotonic time to controller time [s]
+  double toControllerTime(double hostTime);
+  //! Converts a controller time to host monotonic time [s]
+  double toHostTime(double controllerTime);
+  //! Returns the current estimate
+  ClockSyncState getState();
+
+private:
+  //! refits the estimate over the ticks in the window
+  void fit();
+
+  struct Tick {
+      double seconds; //!< controller time of the tick, relative to base
+      double host; //!< host arrival time, relative to base
+  };
+
+  boost::mutex mutex; //!< guards everything below
+  ClockSyncOptions options;
+  double telemetryPeriod; //!< period of the ?TM responses [s], 0 if unknown
+  std::deque<Tick> ticks;
+  bool haveLast;
+  long lastSeconds; //!< last controller time seen
+  double lastHost; //!< arrival time of the last response
+  long baseSeconds; //!< controller time subtracted for precision
+  double baseHost; //!< host time subtracted for precision
+  double intercept; //!< fitted host time at controller time zero, relative
+  double slope; //!< fitted host seconds per controller second
+  ClockSyncState state;
+};
+
+}
+
+#endif
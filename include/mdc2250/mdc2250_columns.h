@@ -0,0 +1,241 @@
+/*!
+ * \file mdc2250/mdc2250_columns.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a compressed column file of status updates decoded from a
+ * Roboteq MDC2250, indexed by time for range queries.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_COLUMNS_H
+#define MDC2250_COLUMNS_H
+
+// Standard Library Headers
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Boost Headers (system or from vender/*)
+#include "boost/cstdint.hpp"
+
+// Library Headers
+#include "mdc2250_types.h"
+
+namespace mdc2250 {
+
+static const boost::uint32_t COLUMN_MAGIC = 0x4d444354; //!< "MDCT"
+static const boost::uint32_t COLUMN_VERSION = 1; //!< layout version of column files
+static const size_t COLUMN_BLOCK_ROWS = 65536; //!< default number of rows per block
+static const size_t COLUMN_MAX_BLOCK_ROWS = 1048576; //!< most rows a block may hold
+
+namespace column {
+  /*!
+   * Columns of a column file, one per status field plus the update time
+   * and the query that caused the update.  Values are stored in the
+   * controller's units, as in mdc2250_raw_status.
+   */
+  typedef enum {
+    _TIME = 0,          /*!< Time of the update [us] */
+    _QUERY = 1,         /*!< RuntimeQuery::runtimeQuery of the update */
+    _E1_COUNT = 2,      /*!< Encoder 1 absolute count */
+    _E2_COUNT = 3,      /*!< Encoder 2 absolute count */
+    _E1_REL_COUNT = 4,  /*!< Encoder 1 relative count */
+    _E2_REL_COUNT = 5,  /*!< Encoder 2 relative count */
+    _E1_RPM = 6,        /*!< Encoder 1 speed [rpm] */
+    _E2_RPM = 7,        /*!< Encoder 2 speed [rpm] */
+    _M1_CMD = 8,        /*!< Motor 1 command */
+    _M2_CMD = 9,        /*!< Motor 2 command */
+    _M1_DECIAMPS = 10,  /*!< Motor 1 current [0.1 A] */
+    _M2_DECIAMPS = 11,  /*!< Motor 2 current [0.1 A] */
+    _B1_DECIAMPS = 12,  /*!< Battery current 1 [0.1 A] */
+    _B2_DECIAMPS = 13,  /*!< Battery current 2 [0.1 A] */
+    _DRIVER_DECIVOLTS = 14, /*!< Driver voltage [0.1 V] */
+    _BAT_DECIVOLTS = 15,    /*!< Main battery voltage [0.1 V] */
+    _FIVEV_MILLIVOLTS = 16, /*!< 5V output voltage [mV] */
+    _FAULTS = 17,       /*!< Fault flags */
+    COUNT = 18
+  } Column;
+}
+
+//! Returns the name of a column, used as the CSV header
+const char* columnName(int column);
+
+/*!
+ * Rows of status updates, stored column by column.
+ */
+struct ColumnSet {
+    std::vector<boost::int64_t> values[column::COUNT];
+
+    //! Returns the number of rows
+    size_t rows() const { return values[column::_TIME].size(); }
+    //! Removes every row
+    void clear();
+    //! Reserves room for a number of rows in every column
+    void reserve(size_t rows);
+    //! Appends a row for an update
+    void append(boost::int64_t time, int query, const mdc2250_raw_status &status);
+    //! Appends rows [begin, end) of another set
+    void append(const ColumnSet &other, size_t begin, size_t end);
+    //! Fills a status with a row, status.time in seconds
+    void getStatus(size_t row, mdc2250_raw_status &status) const;
+};
+
+//! An encoded block of rows, ready to be written
+struct ColumnBlock {
+    std::string data; //!< encoded columns
+    boost::uint32_t rows; //!< number of rows in the block
+    boost::int64_t minTime; //!< earliest time in the block [us]
+    boost::int64_t maxTime; //!< latest time in the block [us]
+};
+
+/*!
+ * Encodes rows [begin, end) of a set into a block.
+ *
+ * Every column is delta encoded, zigzag mapped and written as variable
+ * length integers, and runs of unchanged values collapse into a single
+ * token.  Counters and times that advance steadily take one or two bytes
+ * per row and fields that rarely change next to nothing.  Blocks are
+ * independent, so they can be encoded on several threads.
+ */
+void encodeBlock(const ColumnSet &set, size_t begin, size_t end, ColumnBlock &block);
+
+/*!
+ * Decodes a block and appends its rows to a set.
+ *
+ * \return false if the block is corrupt or holds more than
+ * COLUMN_MAX_BLOCK_ROWS rows
+ */
+bool decodeBlock(const char *data, size_t length, size_t rows, ColumnSet &set);
+
+//! Locates a block in a column file
+struct ColumnIndexEntry {
+    boost::uint64_t offset; //!< file offset of the block
+    boost::uint32_t rows; //!< number of rows in the block
+    boost::uint32_t length; //!< encoded size of the block [bytes]
+    boost::int64_t minTime; //!< earliest time in the block [us]
+    boost::int64_t maxTime; //!< latest time in the block [us]
+};
+
+/*!
+ * Writes a column file.
+ *
+ * A file is a header, the blocks in the order written, an index with the
+ * offset, row count and time range of every block and a trailer locating
+ * the index.  Readers use the index to decode only the blocks of a time
+ * range.  All values are stored in host byte order.
+ */
+class ColumnWriter {
+public:
+    ColumnWriter();
+    ~ColumnWriter();
+
+    /*!
+     * Creates the file, replacing an existing one.
+     *
+     * \return false if the file could not be created
+     */
+    bool open(const std::string &path);
+    //! Appends an encoded block, false if it holds more than COLUMN_MAX_BLOCK_ROWS rows
+    bool write(const ColumnBlock &block);
+    //! Encodes and appends rows in blocks of blockRows, at most COLUMN_MAX_BLOCK_ROWS
+    bool write(const ColumnSet &set, size_t blockRows=COLUMN_BLOCK_ROWS);
+    /*!
+     * Writes the index and closes the file.
+     *
+     * \return false if anything could not be written
+     */
+    bool close();
+
+    //! Returns the number of rows written
+    boost::uint64_t rows() const { return rowCount; }
+
+private:
+    // Disable copies
+    ColumnWriter(const ColumnWriter&);
+    ColumnWriter& operator=(const ColumnWriter&);
+
+    std::ofstream file;
+    std::vector<ColumnIndexEntry> index;
+    boost::uint64_t offset; //!< file offset of the next block
+    boost::uint64_t rowCount;
+};
+
+/*!
+ * Reads time ranges from a column file.
+ */
+class ColumnReader {
+public:
+    ColumnReader();
+    ~ColumnReader();
+
+    /*!
+     * Opens a file and loads its index.
+     *
+     * The index is checked against the file size before anything is
+     * allocated, so a truncated or damaged file cannot exhaust memory.
+     *
+     * \return false if the file is missing, not a column file or corrupt
+     */
+    bool open(const std::string &path);
+    void close();
+
+    //! Returns true if the last open() failed on a damaged index
+    bool isCorrupt() const { return corrupt; }
+
+    //! Returns the number of rows in the file
+    boost::uint64_t rows() const;
+    //! Returns the earliest and latest time in the file [us]
+    void getTimeRange(boost::int64_t &minTime, boost::int64_t &maxTime) const;
+
+    /*!
+     * Reads the rows with from <= time <= to, in file order.
+     *
+     * Only the blocks whose time range overlaps [from, to] are read.
+     *
+     * \return false if a block could not be read or decoded
+     */
+    bool readRange(boost::int64_t from, boost::int64_t to, ColumnSet &set);
+
+private:
+    // Disable copies
+    ColumnReader(const ColumnReader&);
+    ColumnReader& operator=(const ColumnReader&);
+
+    std::ifstream file;
+    std::vector<ColumnIndexEntry> index;
+    bool corrupt;
+};
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*!
+ * \file mdc2250/mdc2250_commands.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides typed commands for the Roboteq MDC2250 and a batcher that
+ * merges digital output and user variable writes into single frames.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_COMMANDS_H
+#define MDC2250_COMMANDS_H
+
+// Standard Library Headers
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// Boost Headers (system or from vender/*)
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_types.h"
+
+namespace mdc2250 {
+
+static const int DIGITAL_OUTPUTS = 8; //!< digital outputs addressable by !D0/!D1/!DS
+
+/*!
+ * Returns the number of arguments a command takes.
+ *
+ * !M and the channel commands (!G, !P, !S, !C, !CB, !AC, !DC) and !VAR
+ * take two, !DS, !D0, !D1 and !H one, !EX and !MG none.
+ *
+ * \return argument count, or -1 for an unknown item
+ */
+int commandArguments(commanditem::CommandItem item);
+
+/*!
+ * Formats a command, without the trailing '\r'.
+ *
+ * Example: formatCommand(commanditem::_GO,1,500) returns "!G 1 500".
+ *
+ * \param item command to format
+ * \param arg1 first argument, usually the channel, ignored if unused
+ * \param arg2 second argument, usually the value, ignored if unused
+ * \return the command, empty for an unknown item
+ */
+std::string formatCommand(commanditem::CommandItem item, long arg1=0, long arg2=0);
+
+/*!
+ * Collects digital output and user variable writes between flushes.
+ *
+ * Output changes are folded into a shadow of the output register.  Once
+ * the whole register is known, because it was set with setOutputs() or
+ * read back with ?DO, every flush writes it with a single !DS.  Until then
+ * only the changed outputs are written, as !D1/!D0 commands in the same
+ * frame.  Writes to the same user variable replace each other, so only
+ * the latest value is sent.  All commands of a flush are joined with '_'
+ * into frames of at most maxFrame characters.
+ *
+ * A ?DO reply produced before a flushed write took effect would undo it
+ * in the shadow, so read backs are ignored from a flush that writes
+ * outputs until the controller's echo of that write, reported with
+ * outputsEchoed(), comes back.  With the echo disabled the shadow keeps
+ * what was written and later read backs are ignored.
+ *
+ * All methods are thread safe.
+ */
+class CommandBatcher {
+public:
+    /*!
+     * \param maxFrame longest frame returned by take(), '\r' included
+     */
+    explicit CommandBatcher(size_t maxFrame=96);
+
+    /*!
+     * Sets or resets one digital output.
+     *
+     * \param output output number (1 to DIGITAL_OUTPUTS)
+     * \return false if the output number is out of range
+     */
+    bool setOutput(int output, bool state);
+    //! Sets all digital outputs, bit 0 is output 1
+    void setOutputs(int mask);
+    //! Records the outputs read back with ?DO, pending changes are kept
+    void outputsRead(int mask);
+    /*!
+     * Reports the echo of a command frame.
+     *
+     * Only the echo of a frame returned by take() that writes outputs
+     * releases the read backs, the echo of a !DS, !D1 or !D0 sent
+     * otherwise does not.
+     *
+     * \param begin first character of the echoed frame
+     * \param end one past its last character, '\r' excluded
+     */
+    void outputsEchoed(const char *begin, const char *end);
+    //! Returns the outputs as of the last flush plus pending changes
+    int getOutputs();
+
+    //! Sets a user variable (!VAR), replacing a pending write to it
+    void setVariable(int index, long value);
+
+    //! Writes handed out by take(), for giving them back with restore()
+    struct Taken {
+        int changed; //!< outputs written one by one or with !DS
+        bool writeAll; //!< the whole register was set with setOutputs
+        std::map<int,long> variables; //!< !VAR writes
+        std::vector<std::string> frames; //!< frames with output commands, without '\r'
+
+        Taken() : changed(0), writeAll(false) {}
+    };
+
+    //! Returns true if anything is waiting to be flushed
+    bool pending();
+    /*!
+     * Returns the pending writes as frames and clears them.
+     *
+     * \param taken receives what was taken, see restore()
+     * \return zero or more frames, each terminated by '\r'
+     */
+    std::string take(Taken &taken);
+    /*!
+     * Gives back writes whose frames could not be sent.
+     *
+     * The writes become pending again, except where a newer write to the
+     * same output or variable was made after take(), and their frames no
+     * longer hold back read backs.
+     */
+    void restore(const Taken &taken);
+    //! Discards pending writes and forgets the output register
+    void reset();
+
+private:
+    size_t maxFrame;
+
+    boost::mutex mutex; //!< guards the members below
+    int outputs; //!< shadow of the output register, pending changes applied
+    int changed; //!< outputs changed since the last flush
+    bool known; //!< every bit of outputs matches the controller
+    bool writeAll; //!< setOutputs was called since the last flush
+    std::deque<std::string> unechoed; //!< flushed output frames whose echo has not arrived
+    std::map<int,long> variables; //!< pending !VAR writes by index
+};
+
+}
+
+#endif
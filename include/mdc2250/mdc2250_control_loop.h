@@ -0,0 +1,146 @@
+/*!
+ * \file mdc2250/mdc2250_control_loop.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a fixed rate motor command loop for the Roboteq MDC2250
+ * with a lock free latest-value-wins setpoint handoff.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_CONTROL_LOOP_H
+#define MDC2250_CONTROL_LOOP_H
+
+// Standard Library Headers
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_realtime.h"
+
+namespace mdc2250 {
+
+//! Settings of the fixed rate control loop
+struct ControlLoopOptions {
+    long periodUs; //!< time between two !M commands [us]
+    RealtimeOptions realtime; //!< scheduling of the loop thread
+
+    ControlLoopOptions() : periodUs(10000) {}
+};
+
+//! Timing statistics of the fixed rate control loop
+struct ControlLoopStats {
+    unsigned long ticks; //!< loop iterations run
+    unsigned long overruns; //!< ticks skipped because the loop fell behind
+    unsigned long published; //!< setpoints published by the application
+    unsigned long sent; //!< published setpoints that were sent
+    unsigned long dropped; //!< setpoints replaced before they were sent
+    double lastSetpointAge; //!< age of the last new setpoint when it was sent [s]
+    double maxSetpointAge; //!< largest setpoint age when sent [s]
+    double meanSetpointAge; //!< average setpoint age when sent [s]
+    double maxJitter; //!< largest tick wake up delay past the deadline [s]
+};
+
+/*!
+ * Sends exactly one !M command per period from a dedicated thread.
+ *
+ * Application threads hand setpoints to the loop with publish(), which is
+ * lock free and never blocks.  The setpoint lives in a single 64 bit slot
+ * that is overwritten by every publish, so a burst of setpoints collapses
+ * into the latest one instead of queueing on the serial line.  If nothing
+ * new was published during a period the previous setpoint is repeated,
+ * which also keeps the controller watchdog fed.  An optional tick
+ * function runs after each !M, e.g. to flush batched I/O writes at the
+ * loop rate.
+ */
+class ControlLoop {
+public:
+    typedef boost::function<bool(std::string)> SendFunction;
+    typedef boost::function<void()> TickFunction;
+
+    /*!
+     * \param send function used to write the !M commands
+     * \param tick function called on the loop thread after each !M
+     */
+    ControlLoop(SendFunction send, TickFunction tick=TickFunction());
+    ~ControlLoop();
+
+    //! Starts or restarts the loop thread, nothing is sent until the next publish
+    void start(const ControlLoopOptions &options);
+    //! Stops the loop thread
+    void stop();
+    //! Returns true if the loop thread is running
+    bool isRunning() const { return running; }
+
+    /*!
+     * Publishes a new setpoint, replacing any that was not sent yet.
+     *
+     * Safe to call from any number of threads.
+     *
+     * \param cmd1 motor 1 command (-1000 to 1000)
+     * \param cmd2 motor 2 command (-1000 to 1000)
+     */
+    void publish(int cmd1, int cmd2);
+
+    //! Returns the loop statistics since start()
+    ControlLoopStats getStats();
+
+private:
+    void run();
+    boost::uint64_t elapsedMicros() const;
+
+    SendFunction send;
+    TickFunction tick;
+    boost::scoped_ptr<boost::thread> thread;
+    DeadlineTimer timer;
+    ControlLoopOptions options;
+    boost::atomic<bool> running;
+    double epoch; //!< monotonic time the setpoint timestamps are relative to [s]
+
+    boost::atomic<boost::uint64_t> setpoint; //!< packed commands, timestamp and flags
+    boost::atomic<unsigned long> published; //!< setpoints published since start
+
+    boost::mutex statsMutex; //!< guards stats
+    ControlLoopStats stats;
+    double ageSum;
+};
+
+}
+
+#endif
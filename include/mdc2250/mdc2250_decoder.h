@@ -0,0 +1,385 @@
+/*!
+ * \file mdc2250/mdc2250_decoder.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the header only decoder turning controller output into
+ * status updates, dispatched statically to a handler type.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_DECODER_H
+#define MDC2250_DECODER_H
+
+// Standard Library Headers
+#include <cstddef>
+#include <cstring>
+
+// Library Headers
+#include "mdc2250_types.h"
+#include "mdc2250_scan.h"
+
+namespace mdc2250 {
+
+static const int MAX_QUERY_VALUES = 16; //!< most values decoded from one response, e.g. ?VAR
+
+/*!
+ * Handler interface expected by decodeFrame and decodeBuffer.
+ *
+ * Any type providing these members can be used; the calls are resolved at
+ * compile time, so handlers written as plain structs with inline members
+ * are folded into the decode loop.  DecoderHandler itself ignores
+ * everything and can be used as a base to override only some members.
+ */
+struct DecoderHandler {
+    //! A runtime query response was decoded into status
+    void onQuery(const mdc2250_raw_status &status, RuntimeQuery::runtimeQuery query,
+                 const long *values, int count) {}
+    //! A configuration response was decoded
+    void onConfig(long value1, long value2, configitem::ConfigItem item) {}
+    //! The controller acknowledged (+) or rejected (-) a command
+    void onAck(bool accepted) {}
+    //! The controller echoed a command or query
+    void onEcho(const char *begin, const char *end) {}
+    //! A frame could not be decoded
+    void onError(const char *reason, const char *begin, const char *end) {}
+};
+
+namespace decoder {
+
+// Returns true if the name [begin, end) equals the literal
+inline bool nameIs(const char *begin, const char *end, const char *literal) {
+    size_t length=end-begin;
+    return (std::strlen(literal)==length)&&(std::memcmp(begin,literal,length)==0);
+}
+
+/*!
+ * Maps the name of a query response to its runtime query.
+ */
+inline RuntimeQuery::runtimeQuery lookupQuery(const char *begin, const char *end) {
+    using namespace RuntimeQuery;
+    switch (end-begin) {
+        case 1:
+            switch (*begin) {
+                case 'A': return _MOTAMPS;
+                case 'M': return _MOTCMD;
+                case 'P': return _MOTPWR;
+                case 'S': return _ABSPEED;
+                case 'C': return _ABCNTR;
+                case 'V': return _VOLTS;
+                case 'D': return _DIGIN;
+                case 'T': return _TEMP;
+                case 'F': return _FEEDBK;
+                case 'E': return _LPERR;
+                default: return _INVALID;
+            }
+        case 2:
+            if (nameIs(begin,end,"CB")) return _BLCNTR;
+            if (nameIs(begin,end,"SR")) return _RELSPEED;
+            if (nameIs(begin,end,"CR")) return _RELCNTR;
+            if (nameIs(begin,end,"BS")) return _BLSPEED;
+            if (nameIs(begin,end,"BA")) return _BATAMPS;
+            if (nameIs(begin,end,"DI")) return _DIN;
+            if (nameIs(begin,end,"AI")) return _ANAIN;
+            if (nameIs(begin,end,"PI")) return _PLSIN;
+            if (nameIs(begin,end,"FS")) return _STFLAG;
+            if (nameIs(begin,end,"FF")) return _FLTFLAG;
+            if (nameIs(begin,end,"DO")) return _DIGOUT;
+            if (nameIs(begin,end,"TM")) return _TIME;
+            if (nameIs(begin,end,"LK")) return _LOCKED;
+            return _INVALID;
+        case 3:
+            if (nameIs(begin,end,"VAR")) return _VAR;
+            if (nameIs(begin,end,"CBR")) return _BLRCNTR;
+            if (nameIs(begin,end,"BSR")) return _BLRSPEED;
+            if (nameIs(begin,end,"CIS")) return _CMDSER;
+            if (nameIs(begin,end,"CIA")) return _CMDANA;
+            if (nameIs(begin,end,"CIP")) return _CMDPLS;
+            return _INVALID;
+        default:
+            return _INVALID;
+    }
+}
+
+/*!
+ * Maps the name of a configuration response to its configuration item.
+ *
+ * \return true if the name is a supported configuration item
+ */
+inline bool lookupConfig(const char *begin, const char *end, configitem::ConfigItem &item) {
+    if (nameIs(begin,end,"EPPR")) {
+        item=configitem::_EPPR;
+        return true;
+    }
+    if (nameIs(begin,end,"MRPM")||nameIs(begin,end,"MXRPM")) {
+        item=configitem::_MXRPM;
+        return true;
+    }
+    if (nameIs(begin,end,"RWD")) {
+        item=configitem::_RWD;
+        return true;
+    }
+    return false;
+}
+
+/*!
+ * Parses a signed decimal integer, advancing position past it.
+ *
+ * \return false if no digits were found
+ */
+inline bool parseLong(const char *&position, const char *end, long &value) {
+    const char *p=position;
+    bool negative=false;
+    if ((p<end)&&((*p=='-')||(*p=='+'))) {
+        negative=(*p=='-');
+        p++;
+    }
+    if ((p>=end)||(*p<'0')||(*p>'9'))
+        return false;
+    long result=0;
+    while ((p<end)&&(*p>='0')&&(*p<='9'))
+        result=result*10+(*p++-'0');
+    value=negative ? -result : result;
+    position=p;
+    return true;
+}
+
+// Returns true if the frame contains a command or query echo marker
+inline bool isEcho(const char *begin, const char *end) {
+    for (const char *p=begin; p<end; p++)
+        if (scan::isEchoMarker(*p))
+            return true;
+    return false;
+}
+
+/*!
+ * Stores decoded values in the raw status, in the controller's units.
+ *
+ * \return false if the response has too few values for the query
+ */
+inline bool applyQuery(mdc2250_raw_status &status, RuntimeQuery::runtimeQuery query,
+                       const long *values, int count) {
+    using namespace RuntimeQuery;
+    switch (query) {
+        case _MOTAMPS:
+            if (count<2) return false;
+            status.M1_deciamps=(boost::int16_t)values[0];
+            status.M2_deciamps=(boost::int16_t)values[1];
+            return true;
+        case _MOTCMD:
+            if (count<2) return false;
+            status.M1_cmd=(boost::int16_t)values[0];
+            status.M2_cmd=(boost::int16_t)values[1];
+            return true;
+        case _ABSPEED:
+            if (count<2) return false;
+            status.E1_rpm=(boost::int32_t)values[0];
+            status.E2_rpm=(boost::int32_t)values[1];
+            return true;
+        case _ABCNTR:
+            if (count<2) return false;
+            status.E1_count=(boost::int32_t)values[0];
+            status.E2_count=(boost::int32_t)values[1];
+            return true;
+        case _RELCNTR:
+            if (count<2) return false;
+            status.E1_rel_count=(boost::int32_t)values[0];
+            status.E2_rel_count=(boost::int32_t)values[1];
+            return true;
+        case _BATAMPS:
+            if (count<2) return false;
+            status.B1_deciamps=(boost::int16_t)values[0];
+            status.B2_deciamps=(boost::int16_t)values[1];
+            return true;
+        case _VOLTS:
+            if (count<3) return false;
+            status.driverDecivolts=(boost::uint16_t)values[0];
+            status.batDecivolts=(boost::uint16_t)values[1];
+            status.fiveVMillivolts=(boost::uint16_t)values[2];
+            return true;
+        case _FLTFLAG:
+            if (count<1) return false;
+            status.faults=(boost::uint8_t)values[0];
+            return true;
+        default:
+            // not stored in the status, the handler still gets the values
+            return true;
+    }
+}
+
+/*!
+ * Decodes a frame known not to be an echo: an acknowledgement or a query
+ * or configuration response.
+ */
+template <class Handler>
+inline void decodeReply(const char *begin, const char *end, mdc2250_raw_status &status, Handler &handler) {
+    // command acknowledgement
+    if ((*begin=='+')||(*begin=='-')) {
+        handler.onAck(*begin=='+');
+        return;
+    }
+
+    // query or configuration response: NAME=v1:v2:...
+    const char *equals=static_cast<const char*>(std::memchr(begin,'=',end-begin));
+    if (equals==NULL) {
+        handler.onError("Incorrectly formed query response",begin,end);
+        return;
+    }
+    long values[MAX_QUERY_VALUES];
+    int count=0;
+    const char *position=equals+1;
+    while ((count<MAX_QUERY_VALUES)&&parseLong(position,end,values[count])) {
+        count++;
+        if ((position>=end)||(*position!=':'))
+            break;
+        position++;
+    }
+
+    RuntimeQuery::runtimeQuery query=lookupQuery(begin,equals);
+    if (query!=RuntimeQuery::_INVALID) {
+        if (!applyQuery(status,query,values,count)) {
+            handler.onError("Incorrectly formed query response",begin,end);
+            return;
+        }
+        handler.onQuery(status,query,values,count);
+        return;
+    }
+
+    configitem::ConfigItem item;
+    if (lookupConfig(begin,equals,item)) {
+        handler.onConfig(count>0 ? values[0] : -1,count>1 ? values[1] : -1,item);
+        return;
+    }
+    handler.onError("Unrecognized query response",begin,end);
+}
+
+// Decodes a frame whose echo markers were already looked for
+template <class Handler>
+inline void decodeScanned(const char *begin, const char *end, bool echo,
+                          mdc2250_raw_status &status, Handler &handler) {
+    // skip empty and single character frames, except acknowledgements
+    if ((end-begin<=1)&&((begin==end)||((*begin!='+')&&(*begin!='-'))))
+        return;
+    if (echo)
+        handler.onEcho(begin,end);
+    else
+        decodeReply(begin,end,status,handler);
+}
+
+}
+
+/*!
+ * Decodes a single frame (one line without its '\r').
+ *
+ * \param begin first character of the frame
+ * \param end one past the last character of the frame
+ * \param status raw status updated by query responses
+ * \param handler receives the decoded frame, see DecoderHandler
+ */
+template <class Handler>
+inline void decodeFrame(const char *begin, const char *end, mdc2250_raw_status &status, Handler &handler) {
+    // echo of a command or query
+    if (decoder::isEcho(begin,end)) {
+        handler.onEcho(begin,end);
+        return;
+    }
+    decoder::decodeReply(begin,end,status,handler);
+}
+
+/*!
+ * Decodes every complete frame in a buffer of controller output.
+ *
+ * Frames are separated by '\r'; empty frames and single characters other
+ * than the '+' and '-' acknowledgements are skipped.  The trailing partial
+ * frame, if any, is not decoded.
+ *
+ * On x86 the buffer is classified 64 bytes at a time with
+ * scan::scanBlock, which finds every '\r' and echo marker in a handful of
+ * vector instructions, so frame boundaries and echoes are known without
+ * looking at each byte again and only replies are parsed.  A backlog of
+ * telemetry after a stall is decoded in one pass.
+ *
+ * \return number of bytes consumed, i.e. up to and including the last '\r'
+ */
+template <class Handler>
+inline size_t decodeBuffer(const char *data, size_t length, mdc2250_raw_status &status, Handler &handler) {
+#if defined(MDC2250_SCAN_SIMD)
+    const char *frame=data;
+    bool echo=false; // the current frame has an echo marker so far
+    size_t offset=0;
+    for (; offset+scan::BLOCK_SIZE<=length; offset+=scan::BLOCK_SIZE) {
+        boost::uint64_t returns, markers;
+        scan::scanBlock(data+offset,returns,markers);
+        boost::uint64_t seen=0; // bits of this block in earlier frames
+        while (returns!=0) {
+            int bit=scan::lowestBit(returns);
+            boost::uint64_t before=(((boost::uint64_t)1)<<bit)-1;
+            echo=echo||((markers&before&~seen)!=0);
+            const char *stop=data+offset+bit;
+            decoder::decodeScanned(frame,stop,echo,status,handler);
+            frame=stop+1;
+            echo=false;
+            seen=before|(((boost::uint64_t)1)<<bit);
+            returns&=returns-1;
+        }
+        echo=echo||((markers&~seen)!=0);
+    }
+
+    // the last partial block
+    for (; offset<length; offset++) {
+        char c=data[offset];
+        if (c=='\r') {
+            decoder::decodeScanned(frame,data+offset,echo,status,handler);
+            frame=data+offset+1;
+            echo=false;
+        } else if (scan::isEchoMarker(c)) {
+            echo=true;
+        }
+    }
+    return frame-data;
+#else
+    const char *end=data+length;
+    const char *frame=data;
+    while (frame<end) {
+        const char *stop=static_cast<const char*>(std::memchr(frame,'\r',end-frame));
+        if (stop==NULL)
+            break;
+        decoder::decodeScanned(frame,stop,decoder::isEcho(frame,stop),status,handler);
+        frame=stop+1;
+    }
+    return frame-data;
+#endif
+}
+
+}
+
+#endif
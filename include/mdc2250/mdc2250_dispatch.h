@@ -0,0 +1,228 @@
+/*!
+ * \file mdc2250/mdc2250_dispatch.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides delivery of status updates to subscribers on their own
+ * threads through bounded lock free rings.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_DISPATCH_H
+#define MDC2250_DISPATCH_H
+
+// Standard Library Headers
+#include <vector>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+// Library Headers
+#include "mdc2250_types.h"
+
+namespace mdc2250 {
+
+namespace overflowpolicy {
+  /*!
+   * Defines what a subscriber's queue does when its worker falls behind.
+   */
+  typedef enum {
+    _DROP_OLDEST = 0,      /*!< Discard the oldest queued update to make room */
+    _COALESCE_LATEST = 1   /*!< Deliver only the newest queued update, skipping the rest */
+  } OverflowPolicy;
+}
+
+/*!
+ * Bounded single producer, single consumer ring of plain old data.
+ *
+ * push() never blocks: when the ring is full it discards the oldest entry
+ * by advancing the consumer's index with a compare and swap.  The consumer
+ * copies an entry before claiming it with a compare and swap too, and
+ * retries if the producer discarded it in the meantime, so a torn copy is
+ * never returned.  The capacity is rounded up to a power of two.
+ */
+template <class T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : head(0), tail(0) {
+        size_t size=2;
+        while (size<capacity)
+            size<<=1;
+        slots.resize(size);
+        mask=size-1;
+    }
+
+    //! Adds an entry, returning false if the oldest one was discarded for it
+    bool push(const T &value) {
+        boost::uint64_t h=head.load(boost::memory_order_relaxed);
+        boost::uint64_t t=tail.load(boost::memory_order_acquire);
+        bool kept=true;
+        // if the exchange fails the consumer just made room
+        if ((h-t>mask)&&tail.compare_exchange_strong(t,t+1))
+            kept=false;
+        slots[h&mask]=value;
+        head.store(h+1,boost::memory_order_release);
+        return kept;
+    }
+
+    //! Takes the oldest entry, returning false if the ring is empty
+    bool pop(T &value) {
+        for (;;) {
+            boost::uint64_t t=tail.load(boost::memory_order_acquire);
+            if (t==head.load(boost::memory_order_acquire))
+                return false;
+            value=slots[t&mask];
+            if (tail.compare_exchange_strong(t,t+1))
+                return true;
+        }
+    }
+
+    /*!
+     * Takes the newest entry and discards everything older.
+     *
+     * \param skipped set to the number of entries discarded
+     */
+    bool popLatest(T &value, boost::uint64_t &skipped) {
+        for (;;) {
+            boost::uint64_t t=tail.load(boost::memory_order_acquire);
+            boost::uint64_t h=head.load(boost::memory_order_acquire);
+            if (t==h)
+                return false;
+            value=slots[(h-1)&mask];
+            if (tail.compare_exchange_strong(t,h)) {
+                skipped=h-1-t;
+                return true;
+            }
+        }
+    }
+
+    //! Returns true if nothing is queued
+    bool empty() const {
+        return tail.load()==head.load();
+    }
+
+    //! Returns the number of queued entries
+    size_t size() const {
+        return (size_t)(head.load()-tail.load());
+    }
+
+private:
+    // Disable copies
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+
+    std::vector<T> slots;
+    size_t mask;
+    // indices on their own cache lines so producer and consumer do not
+    // invalidate each other's
+    char pad0[64];
+    boost::atomic<boost::uint64_t> head; //!< next entry written by the producer
+    char pad1[64];
+    boost::atomic<boost::uint64_t> tail; //!< next entry read by the consumer
+    char pad2[64];
+};
+
+//! Queue settings of one subscriber
+struct SubscriberOptions {
+    size_t capacity; //!< updates queued before the overflow policy applies
+    overflowpolicy::OverflowPolicy policy;
+
+    SubscriberOptions() : capacity(256),
+        policy(overflowpolicy::_DROP_OLDEST) {}
+};
+
+//! Delivery counters of one subscriber
+struct SubscriberStats {
+    unsigned long delivered; //!< updates passed to the callback
+    unsigned long dropped; //!< updates discarded because the queue was full
+    unsigned long coalesced; //!< updates skipped by _COALESCE_LATEST
+    size_t queued; //!< updates waiting right now
+
+    SubscriberStats() : delivered(0), dropped(0), coalesced(0), queued(0) {}
+};
+
+//! One status update as queued for subscribers
+struct QueryEvent {
+    mdc2250_raw_status status; //!< status after the update
+    RuntimeQuery::runtimeQuery query; //!< query that caused the update
+};
+
+/*!
+ * Delivers status updates to subscribers on their own worker threads.
+ *
+ * publish() is called by the read thread; it copies the update into each
+ * subscriber's SpscRing and wakes the worker if it is asleep, without
+ * taking a lock in the common case.  A slow subscriber only ever fills its
+ * own ring, so neither reading nor the other subscribers are held up.
+ */
+class QueryDispatcher {
+public:
+    typedef boost::function<void(const mdc2250_raw_status&, RuntimeQuery::runtimeQuery)> Callback;
+
+    QueryDispatcher();
+    ~QueryDispatcher();
+
+    /*!
+     * Adds a subscriber and starts its worker thread.
+     *
+     * \return id used to remove the subscriber or read its counters
+     */
+    int add(Callback callback, const SubscriberOptions &options);
+    //! Stops the worker of a subscriber and removes it
+    void remove(int id);
+    //! Removes every subscriber
+    void clear();
+    //! Returns the counters of a subscriber, zeros if the id is unknown
+    SubscriberStats getStats(int id);
+
+    //! Queues an update for every subscriber, called from one thread only
+    void publish(const mdc2250_raw_status &status, RuntimeQuery::runtimeQuery query);
+
+private:
+    class Subscriber;
+    typedef std::vector<boost::shared_ptr<Subscriber> > SubscriberList;
+
+    boost::mutex mutex; //!< serializes add and remove
+    boost::shared_ptr<const SubscriberList> subscribers; //!< replaced, never modified
+    int nextId;
+};
+
+}
+
+#endif
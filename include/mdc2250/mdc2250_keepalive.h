@@ -0,0 +1,135 @@
+/*!
+ * \file mdc2250/mdc2250_keepalive.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a deadline driven keepalive that holds off the RS232
+ * watchdog of the Roboteq MDC2250 by resending the last motor command.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_KEEPALIVE_H
+#define MDC2250_KEEPALIVE_H
+
+// Standard Library Headers
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_realtime.h"
+
+namespace mdc2250 {
+
+//! Settings of the watchdog keepalive
+struct KeepaliveOptions {
+    bool enabled; //!< run the keepalive thread, otherwise only ^RWD is set
+    double resendFraction; //!< resend after this fraction of the watchdog period without a command
+    double nearMissFraction; //!< command gaps above this fraction of the watchdog period count as near misses
+    RealtimeOptions realtime; //!< scheduling of the keepalive thread
+
+    KeepaliveOptions() : enabled(true), resendFraction(0.5),
+        nearMissFraction(0.8) {}
+};
+
+//! Timing statistics of the watchdog keepalive
+struct KeepaliveStats {
+    unsigned long wakeups; //!< number of timer wake ups
+    unsigned long resends; //!< motor commands resent by the keepalive
+    unsigned long nearMisses; //!< command gaps above the near miss threshold
+    double maxJitter; //!< largest wake up delay past the deadline [s]
+    double meanJitter; //!< average wake up delay past the deadline [s]
+    double maxCommandGap; //!< largest time between two motor commands [s]
+};
+
+/*!
+ * Keeps the controller's RS232 watchdog (^RWD) from expiring.
+ *
+ * The keepalive tracks when the last motor command was sent.  Its thread
+ * sleeps until that time plus a fraction of the watchdog period and, if no
+ * newer command was sent in the meantime, resends the last one.  Commands
+ * sent by the application push the deadline back, so the keepalive adds no
+ * traffic while the application is commanding the motors itself.  Until a
+ * motor command has been sent nothing is resent.
+ */
+class WatchdogKeepalive {
+public:
+    typedef boost::function<bool(std::string)> SendFunction;
+
+    /*!
+     * \param send function used to write commands to the controller
+     */
+    WatchdogKeepalive(SendFunction send);
+    ~WatchdogKeepalive();
+
+    /*!
+     * Starts or restarts the keepalive thread.
+     *
+     * \param watchdogMs watchdog period configured on the controller [ms]
+     * \param options resend margin and thread scheduling
+     */
+    void start(long watchdogMs, const KeepaliveOptions &options);
+    //! Stops the keepalive thread
+    void stop();
+    //! Returns true if the keepalive thread is running
+    bool isRunning();
+
+    //! Records a motor command that was just sent to the controller
+    void commandSent(const std::string &cmd);
+
+    //! Returns the timing statistics since start()
+    KeepaliveStats getStats();
+
+private:
+    void run();
+    void recordGap(double now);
+
+    SendFunction send;
+    boost::scoped_ptr<boost::thread> thread;
+    DeadlineTimer timer;
+    KeepaliveOptions options;
+    double watchdogPeriod; //!< [s]
+
+    boost::mutex mutex; //!< guards the members below
+    std::string lastCommand; //!< last motor command, empty if none was sent
+    double lastCommandTime; //!< monotonic time lastCommand was sent [s]
+    KeepaliveStats stats;
+    double jitterSum;
+};
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*!
+ * \file mdc2250/mdc2250_link.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides baud rate selection, USB CDC detection and a round trip
+ * and throughput probe for the link to the controller.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_LINK_H
+#define MDC2250_LINK_H
+
+// Standard Library Headers
+#include <string>
+#include <vector>
+
+// Library Headers
+#include "mdc2250_transport.h"
+
+namespace mdc2250 {
+
+/*!
+ * Options for opening the link in MDC2250::connect.
+ *
+ * The controller's RS232 rate is set by its ^RSBR configuration, so the
+ * host has to find it: every rate in baudrates is tried with the ?TRN
+ * handshake, fastest first, and the first that answers is kept.  On a USB
+ * CDC port the rate is not used on the wire and the search is skipped.
+ */
+struct LinkOptions {
+    std::vector<unsigned long> baudrates; //!< line rates to try, defaults to 115200
+    bool detectUsb; //!< use a single attempt on USB CDC ports
+    bool probe; //!< measure the link with probeLink after connecting
+    int probeRoundTrips; //!< ?TRN exchanges timed one at a time
+    int probeBurst; //!< ?TRN requests sent back to back for throughput
+
+    LinkOptions() : detectUsb(true), probe(false), probeRoundTrips(20),
+        probeBurst(100) {
+        baudrates.push_back(115200);
+    }
+};
+
+//! Properties of the open link
+struct LinkInfo {
+    unsigned long baudrate; //!< line rate in use, 0 if the transport has none
+    bool usbCdc; //!< true if the port is a USB CDC ACM device
+    int roundTrips; //!< round trips completed by the probe
+    double rttMin; //!< fastest round trip [s]
+    double rttMean; //!< average round trip [s]
+    double rttMax; //!< slowest round trip [s]
+    long burstBytes; //!< bytes received during the burst
+    double bytesPerSecond; //!< receive throughput during the burst, 0 if not probed
+
+    LinkInfo() : baudrate(0), usbCdc(false), roundTrips(0), rttMin(0.0),
+        rttMean(0.0), rttMax(0.0), burstBytes(0), bytesPerSecond(0.0) {}
+};
+
+/*!
+ * Returns true if port names a USB CDC ACM device.
+ *
+ * On Linux this is the case for /dev/ttyACM* and for any tty whose sysfs
+ * device is bound to the cdc_acm driver; symlinks such as the entries in
+ * /dev/serial/by-id are resolved first.  Always false on other platforms.
+ */
+bool isUsbCdcPort(const std::string &port);
+
+/*!
+ * Measures round trip time and throughput of an open link.
+ *
+ * The transport must be open and not reading continuously.  First
+ * roundTrips ?TRN requests are timed one at a time, then burst requests
+ * are written back to back and the received bytes are timed until every
+ * response has arrived.  Round trip and throughput fields of info are
+ * filled in.
+ *
+ * \return true if every round trip and the burst completed
+ */
+bool probeLink(Transport &transport, int roundTrips, int burst, LinkInfo &info);
+
+}
+
+#endif
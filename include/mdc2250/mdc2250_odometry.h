@@ -0,0 +1,150 @@
+/*!
+ * \file mdc2250/mdc2250_odometry.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides an incremental wheel odometry and velocity estimator fed from
+ * the encoder count queries of the Roboteq MDC2250.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_ODOMETRY_H
+#define MDC2250_ODOMETRY_H
+
+namespace mdc2250 {
+
+//! Geometry and filtering parameters of the odometry estimator
+struct OdometryConfig {
+    double wheelRadius; //!< wheel radius [m]
+    double trackWidth; //!< distance between the left and right wheels [m]
+    double gearRatio; //!< encoder shaft turns per wheel turn
+    int leftChannel; //!< controller channel driving the left wheel (1 or 2)
+    bool invertLeft; //!< negate the left encoder counts, wheel states included
+    bool invertRight; //!< negate the right encoder counts, wheel states included
+    double velocityFilter; //!< low pass weight of the previous velocity, per sample time [0,1)
+
+    OdometryConfig() : wheelRadius(0.1), trackWidth(0.5), gearRatio(1.0),
+        leftChannel(1), invertLeft(false), invertRight(false),
+        velocityFilter(0.0) {}
+};
+
+//! Output of the odometry estimator
+struct OdometryState {
+    double time; //!< monotonic time of the last update [s]
+    double wheelPosition[2]; //!< accumulated wheel angle for channel 1 and 2 [rad]
+    double wheelVelocity[2]; //!< wheel angular velocity for channel 1 and 2 [rad/s]
+    double x; //!< position in the odometry frame [m]
+    double y; //!< position in the odometry frame [m]
+    double theta; //!< heading in the odometry frame [rad]
+    double linearVelocity; //!< forward velocity of the base [m/s]
+    double angularVelocity; //!< yaw rate of the base [rad/s]
+    unsigned long updates; //!< number of encoder samples integrated
+};
+
+/*!
+ * Integrates encoder counts into wheel positions, velocities and a
+ * differential drive pose.
+ *
+ * Each update costs a constant amount of work and never allocates, so it is
+ * safe to run on the serial read thread.  Absolute counter deltas are taken
+ * modulo 2^32, which makes wraparound of the controller's 32 bit counters
+ * transparent.  After the counters are cleared or loaded on the controller
+ * call notifyCounterReset() so the next absolute sample is used as the new
+ * baseline instead of being integrated as a jump.  Call it where the load
+ * takes effect in the reply stream, not when the command is queued, or a
+ * sample read before the load becomes the baseline; MDC2250 does so on
+ * the controller's echo of the !C command.
+ *
+ * The estimator follows whichever of the absolute (?C) or relative (?CR)
+ * count queries it receives first and ignores the other one, so having both
+ * in the telemetry string does not count motion twice.
+ *
+ * Samples may share a time, e.g. a backlog of frames decoded from one read
+ * that all carry its arrival time.  Positions and pose integrate every
+ * sample, while velocities are measured from the last sample of the
+ * previous time to the latest sample, so the last sample of a time yields
+ * the motion over the whole interval rather than over one frame of it.
+ */
+class OdometryEstimator {
+public:
+    OdometryEstimator();
+
+    /*!
+     * Sets the geometry used for the pose and clears the state.
+     *
+     * \return false, keeping the previous configuration, if wheelRadius
+     * or trackWidth is not positive
+     */
+    bool configure(const OdometryConfig &config);
+
+    /*!
+     * Sets the encoder resolution of a channel.
+     *
+     * \param channel controller channel (1 or 2)
+     * \param ppr encoder pulses per revolution, as given to ^EPPR
+     */
+    void setEncoderPPR(int channel, int ppr);
+
+    //! Integrates an absolute counter sample (?C) taken at time t [s]
+    void updateAbsolute(long count1, long count2, double t);
+    //! Integrates a relative counter sample (?CR) taken at time t [s]
+    void updateRelative(long delta1, long delta2, double t);
+
+    //! Marks the absolute counters as reset on the controller
+    void notifyCounterReset();
+    //! Clears the pose, wheel positions and velocities
+    void reset();
+
+    //! Returns the current estimate
+    const OdometryState& getState() const { return state; }
+
+private:
+    enum CountSource { _NONE, _ABSOLUTE, _RELATIVE };
+
+    void integrate(long delta1, long delta2, double t);
+
+    OdometryConfig config;
+    OdometryState state;
+    double radiansPerCount[2]; //!< wheel angle per encoder count by channel
+    long lastCount[2]; //!< last absolute counter values
+    bool haveBaseline; //!< true if lastCount holds a valid baseline
+    bool haveTime; //!< true if state.time holds a valid sample time
+    bool haveAnchor; //!< true if anchorTime holds a previous sample time
+    double anchorTime; //!< last sample time before state.time [s]
+    double anchorPosition[2]; //!< wheel positions of the last sample at anchorTime [rad]
+    double anchorVelocity[2]; //!< filtered wheel velocities at anchorTime [rad/s]
+    CountSource source; //!< count query the estimator is following
+};
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*!
+ * \file mdc2250/mdc2250_realtime.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides deadline timers and real-time thread settings for the
+ * periodic threads of the mdc2250 library.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_REALTIME_H
+#define MDC2250_REALTIME_H
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+namespace mdc2250 {
+
+//! Scheduling settings applied to a library thread when it starts
+struct RealtimeOptions {
+    bool fifoScheduling; //!< run the thread under SCHED_FIFO
+    int priority; //!< SCHED_FIFO priority (1-99)
+    int cpu; //!< pin the thread to this CPU, -1 to leave unpinned
+    bool lockMemory; //!< lock all process memory to avoid page faults
+
+    RealtimeOptions() : fifoScheduling(false), priority(80), cpu(-1),
+        lockMemory(false) {}
+};
+
+/*!
+ * Applies the given scheduling settings to the calling thread.
+ *
+ * Settings that are not supported or not permitted (SCHED_FIFO usually
+ * needs CAP_SYS_NICE) are reported and skipped.
+ *
+ * \return true if every requested setting was applied
+ */
+bool applyRealtimeOptions(const RealtimeOptions &options);
+
+/*!
+ * Sleeps until absolute deadlines on the monotonic clock.
+ *
+ * On Linux this is backed by a timerfd armed with an absolute expiry, so
+ * the wake up is not delayed by the time spent computing the deadline.
+ * Other platforms fall back to a timed condition variable.  A blocked
+ * waitUntil can be interrupted from another thread with cancel().
+ */
+class DeadlineTimer {
+public:
+    DeadlineTimer();
+    ~DeadlineTimer();
+
+    /*!
+     * Blocks until the given time.
+     *
+     * \param deadline absolute time as returned by monotonicTime() [s]
+     * \return false if the wait was cancelled
+     */
+    bool waitUntil(double deadline);
+
+    //! Wakes up a pending waitUntil and makes future waits return false
+    void cancel();
+    //! Clears a previous cancel()
+    void reset();
+
+private:
+    // Disable copies
+    DeadlineTimer(const DeadlineTimer&);
+    DeadlineTimer& operator=(const DeadlineTimer&);
+
+    boost::atomic<bool> cancelled; //!< set by cancel(), cleared by reset()
+#if defined(__linux__)
+    int timerFd; //!< timerfd used for the deadline
+    int cancelFd; //!< eventfd used to interrupt a wait
+#else
+    boost::mutex mutex;
+    boost::condition_variable condition;
+#endif
+};
+
+}
+
+#endif
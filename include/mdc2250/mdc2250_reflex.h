@@ -0,0 +1,142 @@
+/*!
+ * \file mdc2250/mdc2250_reflex.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides fault flag rules that react to controller faults directly
+ * on the serial read thread.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_REFLEX_H
+#define MDC2250_REFLEX_H
+
+// Standard Library Headers
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/function.hpp"
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_types.h"
+
+namespace mdc2250 {
+
+namespace faultaction {
+  /*!
+   * Defines the reactions available to a fault rule.
+   */
+  typedef enum {
+    _ESTOP = 0,        /*!< Emergency stop (!EX) */
+    _ZERO_MOTORS = 1,  /*!< Command both motors to zero (!M 0 0) */
+    _COMMAND = 2       /*!< Send the rule's command string */
+  } FaultAction;
+}
+
+//! A reaction to a change of the controller fault flags
+struct FaultRule {
+    int mask; //!< fault flags watched by the rule, see faultflag::FaultFlag
+    bool onSet; //!< fire when a watched flag is set, otherwise when one clears
+    faultaction::FaultAction action; //!< reaction to take
+    std::string command; //!< command sent by faultaction::_COMMAND
+
+    FaultRule() : mask(0), onSet(true), action(faultaction::_ESTOP) {}
+    FaultRule(int mask, faultaction::FaultAction action)
+        : mask(mask), onSet(true), action(action) {}
+};
+
+//! Statistics of the fault reflexes
+struct ReflexStats {
+    unsigned long evaluations; //!< fault flag samples evaluated
+    unsigned long edges; //!< samples in which any flag changed
+    unsigned long fired; //!< rule actions taken
+    unsigned long failed; //!< rule actions whose command could not be written
+    double lastLatency; //!< fault data arrival to command written for the last action [s]
+    double maxLatency; //!< largest fault to command latency [s]
+    double meanLatency; //!< average fault to command latency [s]
+};
+
+/*!
+ * Evaluates fault rules on transitions of the fault flags.
+ *
+ * update() runs on the serial read thread right after the ?FF response is
+ * decoded and before the runtime query callback, and it takes the rule
+ * actions on that same thread, so the reaction does not wait for any
+ * other thread to be scheduled.  Rules live in a fixed size table, so
+ * evaluation does not allocate.  The flags are assumed clear before the
+ * first sample, so a fault present at start up fires its rules.
+ */
+class FaultReflex {
+public:
+    typedef boost::function<bool(const FaultRule&)> ActionFunction;
+
+    static const int MAX_RULES = 16; //!< size of the rule table
+
+    /*!
+     * \param action function carrying out the action of a fired rule
+     */
+    FaultReflex(ActionFunction action);
+
+    /*!
+     * Adds a rule to the table.
+     *
+     * \return index of the rule, or -1 if the table is full
+     */
+    int addRule(const FaultRule &rule);
+    //! Removes all rules
+    void clearRules();
+
+    /*!
+     * Evaluates the rules against a new fault flag sample.
+     *
+     * \param flags fault flags as reported by ?FF
+     * \param arrivalTime monotonic time the sample was read [s]
+     */
+    void update(int flags, double arrivalTime);
+
+    //! Returns the reflex statistics
+    ReflexStats getStats();
+
+private:
+    ActionFunction action;
+    boost::mutex mutex; //!< guards the rule table, previous flags and stats
+    FaultRule rules[MAX_RULES];
+    int ruleCount;
+    int previousFlags;
+    ReflexStats stats;
+    double latencySum;
+};
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*!
+ * \file mdc2250/mdc2250_scan.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the SSE2/AVX2 scanner that finds frame boundaries and echo
+ * markers in blocks of controller output.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_SCAN_H
+#define MDC2250_SCAN_H
+
+// Boost Headers (system or from vender/*)
+#include "boost/cstdint.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MDC2250_SCAN_SIMD
+#define MDC2250_SCAN_AVX2_TARGET
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MDC2250_SCAN_SIMD
+#define MDC2250_SCAN_SSE2
+// GCC and Clang also compile the AVX2 scanner, used if the CPU has AVX2
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MDC2250_SCAN_AVX2_DISPATCH
+#define MDC2250_SCAN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mdc2250 {
+
+namespace scan {
+
+static const size_t BLOCK_SIZE = 64; //!< bytes classified by one scanBlock call
+
+//! Returns true for the characters that mark an echoed command or query
+inline bool isEchoMarker(char c) {
+    switch (c) {
+        case '!': case '?': case '%': case '~': case '^': case '#':
+            return true;
+        default:
+            return false;
+    }
+}
+
+//! Returns the index of the lowest set bit, mask must not be zero
+inline int lowestBit(boost::uint64_t mask) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index,mask);
+    return (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index,(unsigned long)mask))
+        return (int)index;
+    _BitScanForward(&index,(unsigned long)(mask>>32));
+    return (int)index+32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+#if defined(__AVX2__) || defined(MDC2250_SCAN_AVX2_DISPATCH)
+
+// Classifies 32 bytes, bit n of the results describes data[n]
+MDC2250_SCAN_AVX2_TARGET
+inline void scanHalf(const char *data, boost::uint32_t &returns, boost::uint32_t &markers) {
+    __m256i bytes=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    returns=(boost::uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('\r')));
+    __m256i m=_mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('!')),
+                        _mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('?'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('%')),
+                        _mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('~'))));
+    m=_mm256_or_si256(m,
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('^')),
+                        _mm256_cmpeq_epi8(bytes,_mm256_set1_epi8('#'))));
+    markers=(boost::uint32_t)_mm256_movemask_epi8(m);
+}
+
+// Classifies BLOCK_SIZE bytes with AVX2, see scanBlock
+MDC2250_SCAN_AVX2_TARGET
+inline void scanBlockAvx2(const char *data, boost::uint64_t &returns, boost::uint64_t &markers) {
+    boost::uint32_t r0, m0, r1, m1;
+    scanHalf(data,r0,m0);
+    scanHalf(data+32,r1,m1);
+    returns=r0|((boost::uint64_t)r1<<32);
+    markers=m0|((boost::uint64_t)m1<<32);
+}
+
+#endif
+
+#if defined(MDC2250_SCAN_AVX2_DISPATCH)
+
+//! Returns true if the CPU running the program supports AVX2
+inline bool hasAvx2() {
+    static const bool supported=(__builtin_cpu_init(),__builtin_cpu_supports("avx2")!=0);
+    return supported;
+}
+
+#endif
+
+#if defined(MDC2250_SCAN_SSE2)
+
+// Classifies 16 bytes, bit n of the results describes data[n]
+inline void scanQuarter(const char *data, boost::uint32_t &returns, boost::uint32_t &markers) {
+    __m128i bytes=_mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    returns=(boost::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes,_mm_set1_epi8('\r')));
+    __m128i m=_mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes,_mm_set1_epi8('!')),
+                     _mm_cmpeq_epi8(bytes,_mm_set1_epi8('?'))),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes,_mm_set1_epi8('%')),
+                     _mm_cmpeq_epi8(bytes,_mm_set1_epi8('~'))));
+    m=_mm_or_si128(m,
+        _mm_or_si128(_mm_cmpeq_epi8(bytes,_mm_set1_epi8('^')),
+                     _mm_cmpeq_epi8(bytes,_mm_set1_epi8('#'))));
+    markers=(boost::uint32_t)_mm_movemask_epi8(m);
+}
+
+#endif
+
+#if defined(MDC2250_SCAN_SIMD)
+
+/*!
+ * Classifies a block of BLOCK_SIZE bytes.
+ *
+ * Bit n of returns is set if data[n] is '\r' and bit n of markers if it
+ * is an echo marker.  Uses AVX2 when compiled with it, SSE2 otherwise.
+ * GCC and Clang builds without AVX2 also carry an AVX2 scanner compiled
+ * for that function alone, which is only called after the CPU was found
+ * to support it, so the library runs on any x86-64 CPU.  Without SSE2
+ * MDC2250_SCAN_SIMD is not defined and the decoder falls back to memchr.
+ */
+inline void scanBlock(const char *data, boost::uint64_t &returns, boost::uint64_t &markers) {
+#if defined(__AVX2__)
+    scanBlockAvx2(data,returns,markers);
+#else
+#if defined(MDC2250_SCAN_AVX2_DISPATCH)
+    if (hasAvx2()) {
+        scanBlockAvx2(data,returns,markers);
+        return;
+    }
+#endif
+    boost::uint32_t r[4], m[4];
+    for (int i=0; i<4; i++)
+        scanQuarter(data+16*i,r[i],m[i]);
+    returns=r[0]|((boost::uint64_t)r[1]<<16)|((boost::uint64_t)r[2]<<32)|((boost::uint64_t)r[3]<<48);
+    markers=m[0]|((boost::uint64_t)m[1]<<16)|((boost::uint64_t)m[2]<<32)|((boost::uint64_t)m[3]<<48);
+#endif
+}
+
+#endif
+
+}
+
+}
+
+#endif
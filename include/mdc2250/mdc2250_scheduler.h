@@ -0,0 +1,196 @@
+/*!
+ * \file mdc2250/mdc2250_scheduler.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the prioritized command writer of the mdc2250 library.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_SCHEDULER_H
+#define MDC2250_SCHEDULER_H
+
+// Standard Library Headers
+#include <deque>
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+// Library Headers
+#include "mdc2250_realtime.h"
+
+namespace mdc2250 {
+
+namespace commandpriority {
+  /*!
+   * Defines the priority classes of commands sent to the controller.
+   *
+   * Only the safety class is written ahead of other commands, the other
+   * classes share one queue and are kept for statistics and for discarding
+   * motion commands on an emergency stop.
+   */
+  typedef enum {
+    _SAFETY = 0,  /*!< Emergency stop and release (!EX, !MG) */
+    _MOTION = 1,  /*!< Motor commands (!G, !M, ...) */
+    _QUERY = 2,   /*!< Queries and query history (?, #, ~) */
+    _CONFIG = 3   /*!< Configuration and maintenance (^, %) */
+  } CommandPriority;
+
+  static const int COUNT = 4; //!< number of priority classes
+}
+
+/*!
+ * Returns the priority class of a command based on its prefix.
+ *
+ * A string holding several commands is classified by its first one and
+ * queued as a whole.
+ */
+commandpriority::CommandPriority classifyCommand(const std::string &cmd);
+
+//! Settings of the command scheduler
+struct SchedulerOptions {
+    size_t maxBatch; //!< largest number of bytes combined into one write
+    RealtimeOptions realtime; //!< scheduling of the writer thread
+
+    SchedulerOptions() : maxBatch(64) {}
+};
+
+//! Statistics of the command scheduler
+struct SchedulerStats {
+    unsigned long queued[commandpriority::COUNT]; //!< commands queued by class
+    unsigned long written[commandpriority::COUNT]; //!< commands written by class
+    unsigned long writes; //!< write calls made to the port
+    unsigned long writeErrors; //!< failed write calls
+    unsigned long purged; //!< motion commands discarded by stopping safety commands
+    double maxQueueDelay[commandpriority::COUNT]; //!< largest enqueue to write delay by class [s]
+    unsigned long safetyCommands; //!< safety commands written
+    double lastSafetyWait; //!< time the last safety command waited for the port [s]
+    double maxSafetyWait; //!< largest time a safety command waited for the port [s]
+    double meanSafetyWait; //!< average time safety commands waited for the port [s]
+    double maxSafetyLatency; //!< largest call to write complete time of a safety command [s]
+};
+
+/*!
+ * Serializes all writes to the controller.
+ *
+ * Motion, query and configuration commands share one queue and are written
+ * by a writer thread in the order they were sent.  Queued commands are
+ * combined into writes of at most maxBatch bytes, but a command is never
+ * split, so the port is only ever held for one batch at a time.
+ *
+ * Safety commands do not queue.  They are written from the calling thread
+ * as soon as the batch currently on the wire completes, and the writer
+ * thread holds back further batches until they are out, so their latency
+ * is bounded by the transmit time of a single batch.  A safety command that
+ * stops the motors can also discard the queued motion commands, so they
+ * cannot drive the motors again after it.
+ */
+class CommandScheduler {
+public:
+    typedef boost::function<bool(const std::string&)> WriteFunction;
+
+    /*!
+     * \param write function writing raw bytes to the port
+     */
+    CommandScheduler(WriteFunction write);
+    ~CommandScheduler();
+
+    //! Starts the writer thread
+    void start(const SchedulerOptions &options);
+    //! Writes out the queued commands and stops the writer thread
+    void stop();
+    //! Returns true if the writer thread is running
+    bool isRunning() const { return running; }
+
+    /*!
+     * Sends a command with the given priority.
+     *
+     * Safety commands, and all commands while the writer thread is not
+     * running, are written before this returns.  Other commands are queued
+     * and a failed write is only counted in SchedulerStats::writeErrors.
+     *
+     * \param purgeMotion discard the queued motion commands before a safety
+     * command is written, ignored for other classes
+     * \return false if the command was written and the write failed, or
+     * the writer thread is stopping
+     */
+    bool send(const std::string &cmd, commandpriority::CommandPriority priority,
+              bool purgeMotion=false);
+
+    /*!
+     * Blocks until every command queued so far has been written.
+     *
+     * \param timeout longest time to wait [s]
+     * \return false if commands were still queued or being written
+     */
+    bool waitUntilWritten(double timeout);
+
+    //! Returns the scheduler statistics
+    SchedulerStats getStats();
+
+private:
+    struct QueuedCommand {
+        std::string cmd;
+        commandpriority::CommandPriority priority;
+        double enqueueTime;
+    };
+
+    void run();
+    bool sendSafety(const std::string &cmd, bool purgeMotion);
+    bool writeDirect(const std::string &cmd);
+
+    WriteFunction write;
+    boost::scoped_ptr<boost::thread> thread;
+    SchedulerOptions options;
+    boost::atomic<bool> running;
+
+    boost::mutex portMutex; //!< held for the duration of each write
+    boost::atomic<int> safetyPending; //!< safety commands waiting for the port
+
+    boost::mutex queueMutex; //!< guards queue, stopping and stats
+    boost::condition_variable queueCondition;
+    std::deque<QueuedCommand> queue; //!< non-safety commands in the order sent
+    bool writing; //!< the writer thread is writing a batch taken from queue
+    bool stopping;
+    SchedulerStats stats;
+    double safetyWaitSum;
+};
+
+}
+
+#endif
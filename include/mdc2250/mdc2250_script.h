@@ -0,0 +1,87 @@
+/*!
+ * \file mdc2250/mdc2250_script.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides loading and checking of compiled MicroBasic scripts for
+ * upload to the Roboteq MDC2250.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_SCRIPT_H
+#define MDC2250_SCRIPT_H
+
+// Standard Library Headers
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace mdc2250 {
+
+namespace scriptcommand {
+  /*!
+   * Defines the arguments of the MicroBasic run command (!R).
+   */
+  typedef enum {
+    _STOP = 0,    /*!< Stop the script */
+    _RUN = 1,     /*!< Start or resume the script */
+    _RESTART = 2  /*!< Restart the script with its variables reset */
+  } ScriptCommand;
+}
+
+//! Password the controller expects with the script load command (%SLD)
+static const char SCRIPT_LOAD_KEY[] = "321654987";
+
+/*!
+ * Reads a compiled MicroBasic script in Intel HEX format.
+ *
+ * Scripts are compiled to Intel HEX by the Roborun+ utility.  Every record
+ * is checked for its format and checksum, and the script must end with an
+ * end of file record.  Blank lines are skipped.
+ *
+ * \param input stream holding the HEX text
+ * \param records receives the records, without line endings, in order
+ * \return false if a record is malformed or the end of file record is
+ * missing
+ */
+bool parseScriptHex(std::istream &input, std::vector<std::string> &records);
+
+/*!
+ * Reads a compiled MicroBasic script from an Intel HEX file.
+ *
+ * \see parseScriptHex
+ */
+bool loadScriptHex(const std::string &path, std::vector<std::string> &records);
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*!
+ * \file mdc2250/mdc2250_shm.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a shared memory telemetry segment so any number of local
+ * processes can read the status of one Roboteq MDC2250 without touching the
+ * serial port.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_SHM_H
+#define MDC2250_SHM_H
+
+// Standard Library Headers
+#include <string>
+#include <vector>
+
+// Boost Headers (system or from vender/*)
+#include "boost/cstdint.hpp"
+
+// Library Headers
+#include "mdc2250_types.h"
+
+namespace mdc2250 {
+
+static const boost::uint32_t TELEMETRY_SHM_MAGIC = 0x4d444332; //!< "MDC2"
+static const boost::uint32_t TELEMETRY_SHM_VERSION = 3; //!< layout version of the segment
+
+//! One status update as stored in the shared memory segment
+struct TelemetrySample {
+    boost::uint64_t sequence; //!< index of the update since the publisher started
+    double time; //!< monotonic time the update was read [s]
+    boost::int32_t query; //!< RuntimeQuery::runtimeQuery that caused the update
+    mdc2250_raw_status status; //!< controller status after the update
+};
+
+struct TelemetrySegment;
+
+/*!
+ * Publishes status updates into a POSIX shared memory segment.
+ *
+ * The segment holds a header and a ring of the most recent samples.  Every
+ * slot is guarded by its own sequence lock: the single writer makes the
+ * sequence odd, copies the sample and makes it even again, and readers
+ * retry when they see an odd or changed sequence.  Readers never write to
+ * the segment, so any number of them can follow the publisher without
+ * slowing it down or making a system call.
+ *
+ * The segment appears as /dev/shm/<name> on Linux.  Its layout is
+ * identified by TELEMETRY_SHM_MAGIC, TELEMETRY_SHM_VERSION and the sample
+ * size, which readers check before use.
+ */
+class TelemetryPublisher {
+public:
+    TelemetryPublisher();
+    ~TelemetryPublisher();
+
+    /*!
+     * Creates (or recreates) the shared memory segment.
+     *
+     * \param name segment name, e.g. "/mdc2250"
+     * \param history number of samples kept in the ring
+     * \return false if the segment could not be created
+     */
+    bool open(const std::string &name, size_t history);
+    //! Unmaps and unlinks the segment
+    void close();
+    //! Returns true if the segment is open
+    bool isOpen() const { return segment!=NULL; }
+
+    //! Publishes a status update, called from a single thread only
+    void publish(const mdc2250_raw_status &status, int query, double time);
+
+private:
+    // Disable copies
+    TelemetryPublisher(const TelemetryPublisher&);
+    TelemetryPublisher& operator=(const TelemetryPublisher&);
+
+    std::string name;
+    TelemetrySegment *segment;
+    size_t size;
+};
+
+/*!
+ * Reads status updates from a segment created by a TelemetryPublisher.
+ */
+class TelemetryReader {
+public:
+    TelemetryReader();
+    ~TelemetryReader();
+
+    /*!
+     * Maps an existing segment read only.
+     *
+     * \param name segment name given to TelemetryPublisher::open
+     * \return false if the segment does not exist or has another layout
+     */
+    bool open(const std::string &name);
+    //! Unmaps the segment
+    void close();
+    //! Returns true if the segment is open
+    bool isOpen() const { return segment!=NULL; }
+
+    //! Returns the number of samples published so far
+    boost::uint64_t count() const;
+
+    /*!
+     * Copies the most recent sample.
+     *
+     * \return false if nothing was published yet, or if the slot stays
+     * locked because the publisher stopped in the middle of a write
+     */
+    bool readLatest(TelemetrySample &sample) const;
+
+    /*!
+     * Copies up to maxSamples of the most recent samples, newest first.
+     *
+     * Stops at the first sample that was overwritten or is left locked
+     * by a publisher that stopped in the middle of a write.
+     *
+     * \return number of samples copied
+     */
+    size_t readHistory(std::vector<TelemetrySample> &samples, size_t maxSamples) const;
+
+private:
+    // Disable copies
+    TelemetryReader(const TelemetryReader&);
+    TelemetryReader& operator=(const TelemetryReader&);
+
+    bool readSample(boost::uint64_t sequence, TelemetrySample &sample) const;
+
+    const TelemetrySegment *segment;
+    size_t size;
+};
+
+}
+
+#endif
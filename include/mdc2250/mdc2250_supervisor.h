@@ -0,0 +1,190 @@
+/*!
+ * \file mdc2250/mdc2250_supervisor.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides detection of a lost link to the controller and reconnection
+ * with backoff.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_SUPERVISOR_H
+#define MDC2250_SUPERVISOR_H
+
+// Standard Library Headers
+#include <string>
+#include <vector>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_realtime.h"
+
+namespace mdc2250 {
+
+//! Settings of the connection supervisor
+struct SupervisorOptions {
+    double checkPeriod; //!< how often the link is checked [s]
+    double silencePeriods; //!< telemetry periods without data before the link is lost, 0 to never
+    double silenceMargin; //!< added to the silence timeout for scheduling and transfer delays [s]
+    double initialBackoff; //!< wait after the first failed reconnect [s]
+    double maxBackoff; //!< longest wait between reconnect attempts [s]
+
+    SupervisorOptions() : checkPeriod(0.01), silencePeriods(4.0), silenceMargin(0.1),
+        initialBackoff(0.01), maxBackoff(0.25) {}
+};
+
+//! Link losses and recovery times seen by the supervisor
+struct SupervisorStats {
+    unsigned long losses; //!< times the link was found lost
+    unsigned long attempts; //!< reconnect attempts, successful or not
+    unsigned long recoveries; //!< successful reconnects
+    double lastRecoveryTime; //!< detection to restored session of the last loss [s]
+    double maxRecoveryTime; //!< longest detection to restored session [s]
+    double lastOutage; //!< last data before the loss to restored session [s]
+    unsigned long dropped; //!< commands refused or writes failed while the link was down
+};
+
+/*!
+ * Settings sent to the controller during a session, replayed after a
+ * reconnect.
+ *
+ * Each member holds the command last sent for it, empty if it was never
+ * set.
+ */
+struct SessionState {
+    std::string telemetry; //!< ^TELS telemetry plan
+    double telemetryPeriod; //!< period of the telemetry plan [s], 0 without one
+    std::string encoderPPR[2]; //!< ^EPPR per channel
+    std::string maxRPM[2]; //!< ^MRPM per channel
+    std::string watchdog; //!< ^RWD
+    bool continuousRead; //!< continuous reading was started
+
+    SessionState() : telemetryPeriod(0), continuousRead(false) {}
+
+    //! Returns the recorded commands in the order they are replayed
+    std::vector<std::string> commands() const {
+        std::vector<std::string> result;
+        for (int i=0; i<2; i++) {
+            if (!encoderPPR[i].empty())
+                result.push_back(encoderPPR[i]);
+            if (!maxRPM[i].empty())
+                result.push_back(maxRPM[i]);
+        }
+        if (!watchdog.empty())
+            result.push_back(watchdog);
+        // telemetry last, so the first samples reflect the configuration
+        if (!telemetry.empty())
+            result.push_back(telemetry);
+        return result;
+    }
+};
+
+/*!
+ * Watches the link to the controller and reconnects when it is lost.
+ *
+ * The link counts as lost when linkError() was called, for a failed read
+ * or write, or, while a telemetry plan is set, when no data arrived for
+ * silencePeriods of its period plus silenceMargin after data was flowing.
+ * Without telemetry nothing has to arrive, so silence is not a loss.  The supervisor thread then calls the reconnect function
+ * until it succeeds, waiting initialBackoff after the first failure and
+ * doubling the wait up to maxBackoff.  The time from detection to a
+ * successful reconnect is reported to the recovery callback.
+ */
+class ConnectionSupervisor {
+public:
+    typedef boost::function<bool()> ReconnectFunction;
+    typedef boost::function<void(double)> RecoveryCallback;
+
+    /*!
+     * \param reconnect reopens the link and restores the session, returns
+     * true on success
+     */
+    ConnectionSupervisor(ReconnectFunction reconnect);
+    ~ConnectionSupervisor();
+
+    //! Starts or restarts the supervisor thread
+    void start(const SupervisorOptions &options);
+    //! Stops the supervisor thread, waiting for a reconnect in progress
+    void stop();
+    //! Returns true if the supervisor thread is running
+    bool isRunning();
+
+    //! Records that data arrived at the given monotonic time
+    void dataReceived(double time);
+    /*!
+     * Sets the period of the telemetry plan the silence timeout follows.
+     *
+     * \param period telemetry period [s], 0 when no telemetry is sent
+     */
+    void setTelemetryPeriod(double period);
+    //! Reports a read or write failure, the link is reconnected
+    void linkError();
+    //! Counts a command or write lost to a link failure or a reconnect
+    void commandDropped();
+    //! Returns true while a reconnect is in progress
+    bool isReconnecting() { return reconnecting.load(); }
+
+    //! Sets the function called with the recovery time after each reconnect
+    void setRecoveryCallback(RecoveryCallback callback);
+    //! Returns the loss and recovery statistics since start()
+    SupervisorStats getStats();
+
+private:
+    void run();
+    //! reconnects with backoff, returns false if stopped first
+    bool recover(double detected);
+
+    ReconnectFunction reconnect;
+    RecoveryCallback recoveryCallback;
+    boost::scoped_ptr<boost::thread> thread;
+    DeadlineTimer timer;
+    SupervisorOptions options;
+
+    boost::atomic<bool> error; //!< set by linkError until handled
+    boost::atomic<bool> reconnecting;
+    boost::atomic<boost::int64_t> lastData; //!< monotonic time of the last data [us], 0 if none yet
+    boost::atomic<boost::int64_t> telemetryPeriod; //!< period of the telemetry plan [us], 0 without one
+
+    boost::mutex mutex; //!< guards stats and recoveryCallback
+    SupervisorStats stats;
+};
+
+}
+
+#endif
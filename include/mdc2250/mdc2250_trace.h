@@ -0,0 +1,187 @@
+/*!
+ * \file mdc2250/mdc2250_trace.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides opt in tracing of commands, reads and callbacks of the
+ * Roboteq MDC2250 driver, exported in the Chrome trace event format.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_TRACE_H
+#define MDC2250_TRACE_H
+
+// Standard Library Headers
+#include <cstddef>
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+
+// Library Headers
+#include "mdc2250_clock.h"
+
+namespace mdc2250 {
+
+/*!
+ * Timestamped spans and instants recorded by the driver threads.
+ *
+ * Tracing is off by default and then costs one relaxed load per trace
+ * point.  Once enabled, every thread records into its own ring buffer on
+ * first use; recording takes no lock and makes no allocation, the oldest
+ * events of a thread are overwritten when its ring is full.  The ring of a
+ * thread that exits is handed to the next thread that records, keeping
+ * its events until they are overwritten, so the rings are bounded by the
+ * number of threads alive at once, not by restarts.  Every thread gets its
+ * own tid, and events keep the tid and name of the thread that recorded
+ * them even after their ring changed hands.  dump() writes
+ * all rings as Chrome trace JSON, which chrome://tracing and Perfetto
+ * open directly.
+ *
+ * The driver records:
+ *  - sendCommand, enqueue, write, writeSafety and writeDirect for commands
+ *  - read and decode for data from the controller
+ *  - echo, ack and nak instants for the controller's replies
+ *  - query, rawQueryCallback, queryCallback, publish and subscriber for
+ *    the handling of each status update
+ */
+namespace trace {
+
+//! One recorded span or instant
+struct Event {
+    double begin; //!< monotonic time [s]
+    double duration; //!< [s], negative for an instant
+    const char *name; //!< static string naming the trace point
+    long arg; //!< numeric argument, e.g. a byte count or query
+    char label[24]; //!< start of a command or reply, NUL terminated
+};
+
+//! true while tracing is enabled, read with isEnabled()
+extern boost::atomic<bool> enabled;
+
+//! Returns true if tracing is enabled
+inline bool isEnabled() {
+    return enabled.load(boost::memory_order_relaxed);
+}
+
+/*!
+ * Starts recording.
+ *
+ * \param eventsPerThread ring size of threads that record for the first
+ * time, rings created earlier keep their size
+ */
+void enable(size_t eventsPerThread=65536);
+//! Stops recording, recorded events are kept for dump()
+void disable();
+//! Discards everything recorded so far
+void clear();
+
+/*!
+ * Names the calling thread in the trace, name must be a static string.
+ *
+ * Call once when the thread starts; the name is kept even while tracing
+ * is disabled and applies to everything the thread records later.
+ */
+void setThreadName(const char *name);
+
+/*!
+ * Records an event for the calling thread.
+ *
+ * \param name static string naming the trace point
+ * \param begin monotonic start time [s]
+ * \param duration length [s], negative for an instant
+ * \param arg numeric argument, 0 if unused
+ * \param label text copied into the event, may be NULL
+ * \param length number of label characters, at most 23 are kept
+ */
+void record(const char *name, double begin, double duration, long arg,
+            const char *label, size_t length);
+
+//! Records an instant if tracing is enabled
+inline void instant(const char *name, long arg=0) {
+    if (isEnabled())
+        record(name,monotonicTime(),-1,arg,NULL,0);
+}
+
+//! Records an instant labelled with the start of text if tracing is enabled
+inline void instant(const char *name, const char *begin, const char *end, long arg=0) {
+    if (isEnabled())
+        record(name,monotonicTime(),-1,arg,begin,end-begin);
+}
+
+//! Returns the recorded events of all threads as Chrome trace JSON
+std::string toJson();
+/*!
+ * Writes the recorded events of all threads to a Chrome trace JSON file.
+ *
+ * \return false if the file could not be written
+ */
+bool dump(const std::string &path);
+
+/*!
+ * Records the lifetime of a scope as a span.
+ *
+ * Nothing is recorded if tracing was disabled when the span started.
+ */
+class Span {
+public:
+    explicit Span(const char *name, long arg=0)
+        : name(isEnabled() ? name : NULL), label(NULL), length(0), arg(arg),
+          begin(this->name ? monotonicTime() : 0) {}
+    Span(const char *name, const std::string &text, long arg=0)
+        : name(isEnabled() ? name : NULL), label(text.data()),
+          length(text.length()), arg(arg), begin(this->name ? monotonicTime() : 0) {}
+    ~Span() {
+        if (name)
+            record(name,begin,monotonicTime()-begin,arg,label,length);
+    }
+
+    //! Sets the numeric argument recorded with the span
+    void setArg(long value) { arg=value; }
+
+private:
+    // Disable copies
+    Span(const Span&);
+    Span& operator=(const Span&);
+
+    const char *name;
+    const char *label; //!< must outlive the span
+    size_t length;
+    long arg;
+    double begin;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+/*!
+ * \file mdc2250/mdc2250_trajectory.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides a trajectory streamer that feeds position or velocity
+ * setpoints to the Roboteq MDC2250 at a fixed rate.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_TRAJECTORY_H
+#define MDC2250_TRAJECTORY_H
+
+// Standard Library Headers
+#include <deque>
+#include <string>
+#include <vector>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+
+// Library Headers
+#include "mdc2250_realtime.h"
+
+namespace mdc2250 {
+
+namespace trajectorymode {
+  /*!
+   * Defines the setpoint command generated from a trajectory.
+   */
+  typedef enum {
+    _POSITION = 0,  /*!< Closed loop position (!P) */
+    _VELOCITY = 1   /*!< Closed loop speed (!S) */
+  } TrajectoryMode;
+}
+
+//! A sample of a time parameterized trajectory
+struct TrajectoryPoint {
+    double time; //!< time since the start of the trajectory [s]
+    double position; //!< encoder position [counts]
+    double velocity; //!< encoder velocity [counts/s]
+
+    TrajectoryPoint() : time(0), position(0), velocity(0) {}
+    TrajectoryPoint(double time, double position, double velocity)
+        : time(time), position(position), velocity(velocity) {}
+};
+
+//! Settings of the trajectory streamer
+struct TrajectoryOptions {
+    long periodUs; //!< time between two setpoints [us]
+    double lookahead; //!< how far ahead of the current time the profile is sampled [s]
+    trajectorymode::TrajectoryMode mode; //!< setpoint command to stream
+    bool sendAcceleration; //!< in velocity mode also stream !AC/!DC from the profile
+    RealtimeOptions realtime; //!< scheduling of the streamer thread
+
+    TrajectoryOptions() : periodUs(10000), lookahead(0.02),
+        mode(trajectorymode::_POSITION), sendAcceleration(false) {}
+};
+
+//! Throughput and timing statistics of the trajectory streamer
+struct TrajectoryStats {
+    unsigned long ticks; //!< streamer iterations run
+    unsigned long overruns; //!< ticks skipped because the streamer fell behind
+    unsigned long setpoints; //!< setpoint commands sent
+    unsigned long underruns; //!< ticks that ran past the buffered profile
+    double commandRate; //!< setpoint commands per second since start [1/s]
+    double maxTimingError; //!< largest lateness of a setpoint relative to the profile [s]
+    double meanTimingError; //!< average lateness of a setpoint relative to the profile [s]
+    size_t buffered; //!< profile points waiting to be streamed
+};
+
+/*!
+ * Streams a time parameterized profile to the controller.
+ *
+ * The application appends profile points per channel, ahead of time and in
+ * as many pieces as it likes.  A dedicated thread wakes at a fixed period,
+ * samples the profile with cubic Hermite interpolation at the current
+ * trajectory time plus the lookahead, and sends one combined !P or !S line
+ * for all active channels.  The lookahead compensates for the link and
+ * controller delay.  If the buffered profile runs out before endTrajectory
+ * was called the last point is held and an underrun is counted.
+ */
+class TrajectoryStreamer {
+public:
+    typedef boost::function<bool(std::string)> SendFunction;
+
+    /*!
+     * \param send function used to write the setpoint commands
+     */
+    TrajectoryStreamer(SendFunction send);
+    ~TrajectoryStreamer();
+
+    /*!
+     * Starts streaming.  Trajectory time zero is the time of this call and
+     * any previously buffered points are discarded.
+     */
+    void start(const TrajectoryOptions &options);
+    //! Stops streaming
+    void stop();
+    //! Returns true if the streamer thread is running
+    bool isRunning() const { return running; }
+
+    /*!
+     * Appends points to the profile of a channel.
+     *
+     * \param channel controller channel (1 or 2)
+     * \param points points with increasing times, after any already appended
+     * \return false if the channel or the point times are invalid
+     */
+    bool append(int channel, const std::vector<TrajectoryPoint> &points);
+    //! Marks the profile of a channel as complete
+    void finish(int channel);
+    //! Returns true when every active channel has streamed its complete profile
+    bool isDone();
+
+    //! Sets the encoder resolution used to convert velocities for !S and !AC
+    void setEncoderPPR(int channel, int ppr);
+
+    //! Returns the streamer statistics since start()
+    TrajectoryStats getStats();
+
+private:
+    struct Channel {
+        std::deque<TrajectoryPoint> points;
+        bool active; //!< points were appended since start
+        bool finished; //!< no more points will be appended
+        double countsPerRevolution;
+        long lastAcceleration; //!< last !AC/!DC value sent
+    };
+
+    void run();
+    bool sample(Channel &channel, double t, TrajectoryPoint &result, double &acceleration);
+
+    SendFunction send;
+    boost::scoped_ptr<boost::thread> thread;
+    DeadlineTimer timer;
+    TrajectoryOptions options;
+    boost::atomic<bool> running;
+    double startTime; //!< monotonic time of trajectory time zero [s]
+
+    boost::mutex mutex; //!< guards channels and stats
+    Channel channels[2];
+    TrajectoryStats stats;
+    double timingErrorSum;
+};
+
+}
+
+#endif
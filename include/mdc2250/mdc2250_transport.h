@@ -0,0 +1,253 @@
+/*!
+ * \file mdc2250/mdc2250_transport.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the byte transports the MDC2250 class talks through: the
+ * serial port, a pseudo terminal and an in-memory loopback.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250_TRANSPORT_H
+#define MDC2250_TRANSPORT_H
+
+// Standard Library Headers
+#include <string>
+
+// Serial interface library
+#include <serial/serial.h>
+
+// Boost Headers (system or from vender/*)
+#include "boost/atomic.hpp"
+#include "boost/function.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+namespace mdc2250 {
+
+//! Receives data read continuously, valid only for the duration of the call
+typedef boost::function<void(const char*, size_t)> ReadCallback;
+typedef boost::function<void(const std::string&)> ReadErrorCallback;
+
+/*!
+ * Byte stream between the library and a controller.
+ *
+ * Until startContinuousRead() is called data is returned by read(); after
+ * that it is delivered to the read callback instead.  open() and write()
+ * throw std::exception derived errors on failure; a failure while reading
+ * continuously stops reading and is reported to the read error callback.
+ */
+class Transport {
+public:
+  virtual ~Transport() {}
+
+  //! Opens the transport, port is the device or name it should attach to
+  virtual void open(const std::string &port) = 0;
+  //! Closes the transport, stopping continuous reading
+  virtual void close() = 0;
+  //! Returns true if the transport is open
+  virtual bool isOpen() = 0;
+
+  //! Sets the line rate used by the next open(), if the transport has one
+  virtual void setBaudrate(unsigned long baudrate) {}
+  //! Returns the line rate, or 0 if the transport has none
+  virtual unsigned long getBaudrate() { return 0; }
+  //! Sets how long read() waits for data
+  virtual void setTimeoutMilliseconds(long ms) = 0;
+
+  //! Reads up to size bytes, returning early when the timeout expires
+  virtual std::string read(size_t size) = 0;
+  //! Writes data, returning the number of bytes written
+  virtual size_t write(const std::string &data) = 0;
+
+  //! Sets the function receiving data while reading continuously
+  virtual void setReadCallback(ReadCallback callback) = 0;
+  //! Sets the function told why continuous reading failed, on the read thread
+  virtual void setReadErrorCallback(ReadErrorCallback callback) = 0;
+  //! Starts delivering received data to the read callback
+  virtual void startContinuousRead() = 0;
+  //! Stops delivering received data to the read callback
+  virtual void stopContinuousRead() = 0;
+};
+
+/*!
+ * Transport over a serial port (RS232 or USB).
+ *
+ * Continuous reading runs on a thread of its own that reads the port in
+ * chunks of up to 50 bytes, so a failing read is seen and reported.
+ */
+class SerialTransport : public Transport {
+public:
+  SerialTransport();
+  ~SerialTransport();
+
+  void open(const std::string &port);
+  void close();
+  bool isOpen();
+  void setBaudrate(unsigned long baudrate);
+  unsigned long getBaudrate();
+  void setTimeoutMilliseconds(long ms);
+  std::string read(size_t size);
+  size_t write(const std::string &data);
+  void setReadCallback(ReadCallback callback);
+  void setReadErrorCallback(ReadErrorCallback callback);
+  void startContinuousRead();
+  void stopContinuousRead();
+
+private:
+  void readLoop();
+
+  serial::Serial port;
+  unsigned long baudrate;
+  ReadCallback callback;
+  ReadErrorCallback errorCallback;
+  boost::atomic<bool> reading;
+  boost::scoped_ptr<boost::thread> thread;
+};
+
+/*!
+ * Base of the transports that buffer received data themselves.
+ *
+ * Received data is handed to the read callback while reading continuously
+ * and queued for read() otherwise.  Calls of the read callback never
+ * overlap, so a subclass may receive on more than one thread.
+ */
+class BufferedTransport : public Transport {
+public:
+  BufferedTransport();
+
+  void setTimeoutMilliseconds(long ms);
+  std::string read(size_t size);
+  void setReadCallback(ReadCallback callback);
+  void setReadErrorCallback(ReadErrorCallback callback);
+  void startContinuousRead();
+  void stopContinuousRead();
+
+protected:
+  //! Hands received data to the callback or the read buffer
+  void receive(const char *data, size_t length);
+  //! Reports a failed read to the read error callback
+  void readFailed(const std::string &reason);
+  //! Drops buffered data
+  void clearBuffer();
+
+private:
+  boost::mutex mutex; //!< guards buffer, callback and continuous
+  boost::mutex deliverMutex; //!< held while the read callback runs, keeps deliveries in order
+  boost::condition_variable dataAvailable;
+  std::string buffer;
+  ReadCallback callback;
+  ReadErrorCallback errorCallback;
+  bool continuous;
+  long timeoutMs;
+};
+
+#if !defined(_WIN32)
+
+/*!
+ * Transport over the master side of a pseudo terminal.
+ *
+ * open() creates a new pseudo terminal; a controller simulator attaches to
+ * the device returned by slaveName().  Useful for exercising the full tty
+ * path without hardware.
+ */
+class PtyTransport : public BufferedTransport {
+public:
+  PtyTransport();
+  ~PtyTransport();
+
+  void open(const std::string &port);
+  void close();
+  bool isOpen();
+  size_t write(const std::string &data);
+
+  //! Returns the device name of the slave side, e.g. /dev/pts/3
+  std::string slaveName() const { return slave; }
+
+private:
+  void readLoop();
+
+  int master;
+  std::string slave;
+  boost::atomic<bool> reading;
+  boost::scoped_ptr<boost::thread> thread;
+};
+
+#endif
+
+/*!
+ * In-memory transport connected to a peer transport.
+ *
+ * A write on one end appends the data to the inbox of the other end, and
+ * a delivery thread owned by the receiving end, running while it is open,
+ * hands the inbox to the read callback or the read buffer.  The callback
+ * thus never runs on the writer's thread or inside its locks, so a
+ * simulator may answer from its callback.  The inbox is handed over by
+ * swapping buffers, so data is copied once on write, as into a pipe, and
+ * not again.  inject() delivers data as if it had been received, which
+ * drives the parser at memory speed without a peer at all.
+ */
+class LoopbackTransport : public BufferedTransport {
+public:
+  LoopbackTransport();
+  ~LoopbackTransport();
+
+  //! Connects two loopback transports to each other
+  static void connect(LoopbackTransport &a, LoopbackTransport &b);
+
+  void open(const std::string &port);
+  void close();
+  bool isOpen();
+  size_t write(const std::string &data);
+
+  //! Delivers data to this end as if the peer had written it
+  void inject(const std::string &data);
+
+private:
+  //! Queues data for the delivery thread
+  void post(const char *data, size_t length);
+  void deliverLoop();
+
+  LoopbackTransport *peer;
+  boost::atomic<bool> opened;
+  boost::mutex inboxMutex; //!< guards inbox and delivering
+  boost::condition_variable inboxReady;
+  std::string inbox; //!< data received but not yet delivered
+  bool delivering; //!< the delivery thread should keep running
+  boost::scoped_ptr<boost::thread> thread;
+};
+
+}
+
+#endif
@@ -38,6 +38,23 @@
 #ifndef MDC2250_TYPES_H
 #define MDC2250_TYPES_H
 
+// Boost Headers (system or from vender/*)
+#include "boost/cstdint.hpp"
+#include "boost/static_assert.hpp"
+
+/*!
+ * Aligns a type to n bytes, used to give records their own cache line.
+ *
+ * Only for types that are never allocated with new or held in standard
+ * containers: before C++17 those allocations ignore alignments beyond
+ * that of max_align_t.
+ */
+#if defined(_MSC_VER)
+#define MDC2250_ALIGNED(n) __declspec(align(n))
+#else
+#define MDC2250_ALIGNED(n) __attribute__((aligned(n)))
+#endif
+
 namespace mdc2250 {
 
 using namespace mdc2250;
@@ -223,31 +240,31 @@ namespace configitem {
 //   (83, "_KDC2")
 //   (84, "_EHOME");
 
-//namespace commanditem {
-//  /*!
-//   * Defines the possible Command Items.
-//   *
-//   * More information about these commands can be found
-//   * in the Controller's User Manual.
-//   */
-//  typedef enum {
-//    _GO = 0,      /*!< Set Motor1 Command */
-//    _MOTCMD = 1,  /*!< Undocumented */
-//    _MOTPOS = 2,  /*!< Undocumented */
-//    _MOTVEL = 3,  /*!< Undocumented */
-//    _SENCNTR = 4, /*!< Undocumented */
-//    _SBLCNTR = 5, /*!< Undocumented */
-//    _VAR = 6,     /*!< Undocumented */
-//    _ACCEL = 7,   /*!< Set Acceleration */
-//    _DECEL = 8,   /*!< Set Deceleration */
-//    _DOUT = 9,    /*!< Set all Digital Out bits */
-//    _DSET = 10,   /*!< Set Individual Digital Out bits */
-//    _DRES = 11,   /*!< Reset Individual Digital Out bits */
-//    _HOME = 13,   /*!< Load Home counter */
-//    _ESTOP = 14,  /*!< Undocumented */
-//    _MGO = 15     /*!< Undocumented */
-//  } CommandItem;
-//}
+namespace commanditem {
+  /*!
+   * Defines the possible Command Items.
+   *
+   * More information about these commands can be found
+   * in the Controller's User Manual.
+   */
+  typedef enum {
+    _GO = 0,      /*!< Set Motor Command (!G) */
+    _MOTCMD = 1,  /*!< Set Both Motor Commands (!M) */
+    _MOTPOS = 2,  /*!< Set Position (!P) */
+    _MOTVEL = 3,  /*!< Set Velocity (!S) */
+    _SENCNTR = 4, /*!< Set Encoder Counter (!C) */
+    _SBLCNTR = 5, /*!< Set Brushless Counter (!CB) */
+    _VAR = 6,     /*!< Set User Variable (!VAR) */
+    _ACCEL = 7,   /*!< Set Acceleration (!AC) */
+    _DECEL = 8,   /*!< Set Deceleration (!DC) */
+    _DOUT = 9,    /*!< Set all Digital Out bits (!DS) */
+    _DSET = 10,   /*!< Set Individual Digital Out bits (!D1) */
+    _DRES = 11,   /*!< Reset Individual Digital Out bits (!D0) */
+    _HOME = 13,   /*!< Load Home counter (!H) */
+    _ESTOP = 14,  /*!< Emergency Stop (!EX) */
+    _MGO = 15     /*!< Release Emergency Stop (!MG) */
+  } CommandItem;
+}
 
 // // Reverse enum map for error reporting
 // std::map<int, std::string> create_command_names() {
@@ -271,6 +288,136 @@ namespace configitem {
 // }
 // std::map<int, std::string> CommandItemNames = create_command_names();
 
+//! Structure to represent the current status of the controller
+struct mdc2250_status {
+    int id; //!< motor controller ID - used to differentiate data with multiple controllers
+    double M1_amps; //!< motor 1 current [amps]
+    double M2_amps; //!< motor 2 current [amps]
+    double B1_amps; //!< battery current 1 [amps]
+    double B2_amps; //!< battery current 2 [amps]
+    long E1_count; //!< encoder 1 counts - absolute
+    long E2_count; //!< encoder 2 counts - absolute
+    long E1_rel_count; //!< encoder 1 counts - relative
+    long E2_rel_count; //!< encoder 2 counts - relative
+    long M1_cmd; //!< motor 1 command
+    long M2_cmd; //!< motor 2 command
+    long E1_rpm; //!< encoder speed 1 [rpm]
+    long E2_rpm; //!< encoder speed 2 [rpm]
+    double time; //!< time of the update [s], see MDC2250::enableClockSync
+    double driverVoltage; //!< driver voltage [V]
+    double batVoltage; //!< main battery voltage [V]
+    long fiveVVoltage; //!< 5V output voltage [mV]
+
+    // fault flags
+    bool overheat;
+    bool overvoltage;
+    bool undervoltage;
+    bool shortCircuit;
+    bool ESTOP;
+    bool sepexFault;
+    bool EEPROMFault;
+    bool configFault;
+};
+
+namespace faultflag {
+  /*!
+   * Defines the bits of the fault flag query (?FF).
+   */
+  typedef enum {
+    _OVERHEAT = 0x01,       /*!< Overheat */
+    _OVERVOLTAGE = 0x02,    /*!< Overvoltage */
+    _UNDERVOLTAGE = 0x04,   /*!< Undervoltage */
+    _SHORTCIRCUIT = 0x08,   /*!< Short circuit */
+    _ESTOP = 0x10,          /*!< Emergency stop */
+    _SEPEXFAULT = 0x20,     /*!< Sepex excitation fault */
+    _EEPROMFAULT = 0x40,    /*!< MOSFET failure / EEPROM fault */
+    _CONFIGFAULT = 0x80     /*!< Startup configuration fault */
+  } FaultFlag;
+}
+
+/*!
+ * Controller status in the units the controller reports.
+ *
+ * Decoding only stores integers; the accessors convert currents and
+ * voltages to amps and volts when they are read.  The record fits in one
+ * 64 byte cache line, a third of mdc2250_status, which keeps history
+ * buffers, logs and the shared memory export small.  It is not over-aligned
+ * since it is held by value in containers and heap objects; the shared
+ * memory slots holding it are aligned instead.
+ */
+struct mdc2250_raw_status {
+    double time; //!< time of the update [s], see MDC2250::enableClockSync
+    boost::int32_t E1_count; //!< encoder 1 counts - absolute
+    boost::int32_t E2_count; //!< encoder 2 counts - absolute
+    boost::int32_t E1_rel_count; //!< encoder 1 counts - relative
+    boost::int32_t E2_rel_count; //!< encoder 2 counts - relative
+    boost::int32_t E1_rpm; //!< encoder speed 1 [rpm]
+    boost::int32_t E2_rpm; //!< encoder speed 2 [rpm]
+    boost::int16_t M1_cmd; //!< motor 1 command
+    boost::int16_t M2_cmd; //!< motor 2 command
+    boost::int16_t M1_deciamps; //!< motor 1 current [0.1 A]
+    boost::int16_t M2_deciamps; //!< motor 2 current [0.1 A]
+    boost::int16_t B1_deciamps; //!< battery current 1 [0.1 A]
+    boost::int16_t B2_deciamps; //!< battery current 2 [0.1 A]
+    boost::uint16_t driverDecivolts; //!< driver voltage [0.1 V]
+    boost::uint16_t batDecivolts; //!< main battery voltage [0.1 V]
+    boost::uint16_t fiveVMillivolts; //!< 5V output voltage [mV]
+    boost::uint8_t id; //!< motor controller ID
+    boost::uint8_t faults; //!< fault flags, see faultflag::FaultFlag
+
+    double M1_amps() const { return M1_deciamps/10.0; } //!< [A]
+    double M2_amps() const { return M2_deciamps/10.0; } //!< [A]
+    double B1_amps() const { return B1_deciamps/10.0; } //!< [A]
+    double B2_amps() const { return B2_deciamps/10.0; } //!< [A]
+    double driverVoltage() const { return driverDecivolts/10.0; } //!< [V]
+    double batVoltage() const { return batDecivolts/10.0; } //!< [V]
+    long fiveVVoltage() const { return fiveVMillivolts; } //!< [mV]
+
+    //! Returns true if any of the given fault flags is set
+    bool hasFault(int flags) const { return (faults&flags)!=0; }
+    bool overheat() const { return hasFault(faultflag::_OVERHEAT); }
+    bool overvoltage() const { return hasFault(faultflag::_OVERVOLTAGE); }
+    bool undervoltage() const { return hasFault(faultflag::_UNDERVOLTAGE); }
+    bool shortCircuit() const { return hasFault(faultflag::_SHORTCIRCUIT); }
+    bool ESTOP() const { return hasFault(faultflag::_ESTOP); }
+    bool sepexFault() const { return hasFault(faultflag::_SEPEXFAULT); }
+    bool EEPROMFault() const { return hasFault(faultflag::_EEPROMFAULT); }
+    bool configFault() const { return hasFault(faultflag::_CONFIGFAULT); }
+
+    //! Converts every field to engineering units
+    mdc2250_status toStatus() const {
+        mdc2250_status status;
+        status.id=id;
+        status.M1_amps=M1_amps();
+        status.M2_amps=M2_amps();
+        status.B1_amps=B1_amps();
+        status.B2_amps=B2_amps();
+        status.E1_count=E1_count;
+        status.E2_count=E2_count;
+        status.E1_rel_count=E1_rel_count;
+        status.E2_rel_count=E2_rel_count;
+        status.M1_cmd=M1_cmd;
+        status.M2_cmd=M2_cmd;
+        status.E1_rpm=E1_rpm;
+        status.E2_rpm=E2_rpm;
+        status.time=time;
+        status.driverVoltage=driverVoltage();
+        status.batVoltage=batVoltage();
+        status.fiveVVoltage=fiveVVoltage();
+        status.overheat=overheat();
+        status.overvoltage=overvoltage();
+        status.undervoltage=undervoltage();
+        status.shortCircuit=shortCircuit();
+        status.ESTOP=ESTOP();
+        status.sepexFault=sepexFault();
+        status.EEPROMFault=EEPROMFault();
+        status.configFault=configFault();
+        return status;
+    }
+};
+
+BOOST_STATIC_ASSERT(sizeof(mdc2250_raw_status)<=64);
+
 namespace RuntimeQuery {
   /*!
    * Defines the possible Operating Items.
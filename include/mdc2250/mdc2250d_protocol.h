@@ -0,0 +1,264 @@
+/*!
+ * \file mdc2250/mdc2250d_protocol.h
+ * \author David Hodo <david.hodo@gmail.com>
+ * \author William Woodall <wjwwood@gmail.com>
+ * \version 0.1
+ *
+ * \section LICENSE
+ *
+ * The BSD License
+ *
+ * Copyright (c) 2011 William Woodall - David Hodo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides the binary protocol spoken over the Unix domain socket of
+ * the mdc2250d daemon and a minimal client for it.
+ *
+ * This library depends on CMake-2.4.6 or later: http://www.cmake.org/
+ *
+ */
+
+#ifndef MDC2250D_PROTOCOL_H
+#define MDC2250D_PROTOCOL_H
+
+// Standard Library Headers
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+// Boost Headers (system or from vender/*)
+#include "boost/cstdint.hpp"
+
+// Library Headers
+#include "mdc2250_types.h"
+#include "mdc2250_shm.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace mdc2250 {
+
+/*!
+ * Default path of the daemon socket.
+ *
+ * The daemon only listens in a directory it owns that no one else can
+ * write to, e.g. the runtime directory systemd creates for a service with
+ * RuntimeDirectory=mdc2250d, and makes the socket accessible to its user
+ * and group only (0660).
+ */
+static const char * const DAEMON_SOCKET_PATH = "/run/mdc2250d/mdc2250d.sock";
+//! Protocol version sent in the hello message
+static const boost::uint16_t DAEMON_PROTOCOL_VERSION = 2;
+
+namespace daemonmessage {
+  /*!
+   * Defines the message types of the daemon protocol.
+   *
+   * Every message starts with a MessageHeader followed by length bytes of
+   * payload.  All values are in host byte order since the socket is local.
+   */
+  typedef enum {
+    _HELLO = 1,      /*!< daemon -> client: HelloMessage on connect */
+    _SUBSCRIBE = 2,  /*!< client -> daemon: SubscribeMessage */
+    _COMMAND = 3,    /*!< client -> daemon: CommandMessage followed by the command text */
+    _TELEMETRY = 4   /*!< daemon -> client: TelemetryMessage */
+  } MessageType;
+}
+
+//! Header of every daemon message
+struct MessageHeader {
+    boost::uint16_t length; //!< payload bytes following the header
+    boost::uint8_t type; //!< daemonmessage::MessageType
+    boost::uint8_t reserved;
+};
+
+//! Sent by the daemon when a client connects
+struct HelloMessage {
+    boost::uint16_t version; //!< DAEMON_PROTOCOL_VERSION
+    boost::uint16_t sampleSize; //!< sizeof(TelemetrySample) of the daemon
+};
+
+//! Selects the runtime queries a client receives
+struct SubscribeMessage {
+    boost::uint32_t queryMask; //!< bit n set receives RuntimeQuery::runtimeQuery n
+};
+
+//! Asks the daemon to send a command to the controller
+struct CommandMessage {
+    /*!
+     * commandpriority::CommandPriority, 0xff to classify by prefix.  The
+     * daemon always derives the class from the command; a client may only
+     * ask for a lower class.  The safety class is only given to a lone !EX
+     * or !MG, which keep it, anything sent along with them is queued as
+     * motion.
+     */
+    boost::uint8_t priority;
+};
+
+//! A status update forwarded to a subscribed client
+struct TelemetryMessage {
+    boost::uint32_t dropped; //!< updates dropped for this client since the last message
+    TelemetrySample sample; //!< the update itself
+};
+
+//! Returns the subscription bit of a runtime query
+inline boost::uint32_t queryBit(RuntimeQuery::runtimeQuery query) {
+    return (query>=0)&&(query<32) ? (1u<<query) : 0;
+}
+
+#if !defined(_WIN32)
+
+/*!
+ * Minimal blocking client of the mdc2250d daemon.
+ */
+class DaemonClient {
+public:
+    DaemonClient() : fd(-1) {}
+    ~DaemonClient() { close(); }
+
+    /*!
+     * Connects to the daemon.
+     *
+     * \param path socket path of the daemon
+     * \return false if the daemon is not reachable or speaks another version
+     */
+    bool connect(const std::string &path=DAEMON_SOCKET_PATH) {
+        close();
+        fd=socket(AF_UNIX,SOCK_STREAM,0);
+        if (fd<0)
+            return false;
+        struct sockaddr_un address;
+        std::memset(&address,0,sizeof(address));
+        address.sun_family=AF_UNIX;
+        std::strncpy(address.sun_path,path.c_str(),sizeof(address.sun_path)-1);
+        if (::connect(fd,(struct sockaddr*)&address,sizeof(address))!=0) {
+            close();
+            return false;
+        }
+        MessageHeader header;
+        HelloMessage hello;
+        if (!readExact(&header,sizeof(header))||(header.type!=daemonmessage::_HELLO)
+            ||(header.length!=sizeof(hello))||!readExact(&hello,sizeof(hello))
+            ||(hello.version!=DAEMON_PROTOCOL_VERSION)||(hello.sampleSize!=sizeof(TelemetrySample))) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    //! Closes the connection
+    void close() {
+        if (fd>=0)
+            ::close(fd);
+        fd=-1;
+    }
+
+    //! Selects the runtime queries to receive, see queryBit()
+    bool subscribe(boost::uint32_t queryMask) {
+        SubscribeMessage message;
+        message.queryMask=queryMask;
+        return sendMessage(daemonmessage::_SUBSCRIBE,&message,sizeof(message),NULL,0);
+    }
+
+    //! Sends a command, classified by the daemon; a priority can only lower its class
+    bool sendCommand(const std::string &cmd, int priority=0xff) {
+        CommandMessage message;
+        message.priority=(boost::uint8_t)priority;
+        return sendMessage(daemonmessage::_COMMAND,&message,sizeof(message),cmd.data(),cmd.length());
+    }
+
+    /*!
+     * Blocks until the next status update arrives.
+     *
+     * \return false if the connection was lost
+     */
+    bool readTelemetry(TelemetryMessage &message) {
+        MessageHeader header;
+        while (readExact(&header,sizeof(header))) {
+            if ((header.type==daemonmessage::_TELEMETRY)&&(header.length==sizeof(message)))
+                return readExact(&message,sizeof(message));
+            // skip messages this client does not know
+            char discard[256];
+            size_t remaining=header.length;
+            while (remaining>0) {
+                size_t chunk=remaining<sizeof(discard) ? remaining : sizeof(discard);
+                if (!readExact(discard,chunk))
+                    return false;
+                remaining-=chunk;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool sendMessage(int type, const void *body, size_t bodyLength,
+                     const void *extra, size_t extraLength) {
+        MessageHeader header;
+        header.length=(boost::uint16_t)(bodyLength+extraLength);
+        header.type=(boost::uint8_t)type;
+        header.reserved=0;
+        std::string buffer((const char*)&header,sizeof(header));
+        buffer.append((const char*)body,bodyLength);
+        if (extraLength>0)
+            buffer.append((const char*)extra,extraLength);
+        return writeExact(buffer.data(),buffer.length());
+    }
+
+    bool readExact(void *data, size_t length) {
+        char *position=(char*)data;
+        while (length>0) {
+            ssize_t n=::read(fd,position,length);
+            if ((n<0)&&(errno==EINTR))
+                continue;
+            if (n<=0)
+                return false;
+            position+=n;
+            length-=n;
+        }
+        return true;
+    }
+
+    bool writeExact(const void *data, size_t length) {
+        const char *position=(const char*)data;
+        while (length>0) {
+            ssize_t n=::send(fd,position,length,MSG_NOSIGNAL);
+            if ((n<0)&&(errno==EINTR))
+                continue;
+            if (n<=0)
+                return false;
+            position+=n;
+            length-=n;
+        }
+        return true;
+    }
+
+    int fd;
+};
+
+#endif
+
+}
+
+#endif
@@ -1,8 +1,13 @@
 #include "mdc2250/mdc2250.h"
+#include "mdc2250/mdc2250_clock.h"
+#include "mdc2250/mdc2250_decoder.h"
+#include "mdc2250/mdc2250_trace.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <sstream>
 #include <vector>
-#include <boost/foreach.hpp>
-#include <boost/algorithm/string.hpp>
 using namespace mdc2250;
 using namespace RuntimeQuery;
 using namespace configitem;
@@ -15,67 +20,64 @@ inline void defaultExceptionCallback(const std::exception &error) {
   throw(error);
 }
 
-inline void defaultRuntimeQueryCallback(mdc2250_status status, runtimeQuery queryType) {
-    //std::cout << "Parsed runtime query: " << queryType << std::endl;
+// Converts the raw status for a subscriber added with addQuerySubscriber
+inline void callConverted(RuntimeQueryCallback callback, const mdc2250_raw_status &status,
+                          runtimeQuery queryType) {
+    callback(status.toStatus(),queryType);
 }
 
 inline void defaultConfigCallback(long value1, long value2, ConfigItem configType) {
     //std::cout << "Parsed config data: " << configType << std::endl;
 }
 
-// Reverse enum map for parsing query items
-std::map<std::string, runtimeQuery> create_query_names() {
-  std::map<std::string, runtimeQuery> m;
-  m["A"] = _MOTAMPS;
-  m["M"] = _MOTCMD;
-  m["P"] = _MOTPWR;
-  m["S"] = _ABSPEED;
-  m["C"] = _ABCNTR;
-  m["CB"] = _BLCNTR;
-  m["VAR"] = _VAR;
-  m["SR"] = _RELSPEED;
-  m["CR"] = _RELCNTR;
-  m["CBR"] = _BLRCNTR;
-  m["BS"] = _BLSPEED;
-  m["BSR"] = _BLRSPEED;
-  m["A"] = _BATAMPS;
-  m["V"] = _VOLTS;
-  m["D"] = _DIGIN;
-  m["DI"] = _DIN;
-  m["AI"] = _ANAIN;
-  m["PI"] = _PLSIN;
-  m["T"] = _TEMP;
-  m["F"] = _FEEDBK;
-  m["FS"] = _STFLAG;
-  m["FF"] = _FLTFLAG;
-  m["DO"] = _DIGOUT;
-  m["E"] = _LPERR;
-  m["CIS"] = _CMDSER;
-  m["CIA"] = _CMDANA;
-  m["CIP"] = _CMDPLS;
-  m["TM"] = _TIME;
-  m["LK"] = _LOCKED;
-  return m;
-}
-
-// Reverse enum map for parsing config items
-std::map<std::string, ConfigItem> create_config_names() {
-  std::map<std::string, ConfigItem> m;
-  m["MRPM"] = _MXRPM;
-  m["EPPR"] = _EPPR;
-  return m;
+inline void defaultOdometryCallback(OdometryState state) {
 }
 
 /***** MDC2250 Class Functions *****/
 
-MDC2250::MDC2250() {
+MDC2250::MDC2250()
+    : transport(new SerialTransport()),
+      scheduler(boost::bind(&MDC2250::writePort,this,_1)),
+      supervisor(boost::bind(&MDC2250::reconnectLink,this)),
+      adaptiveTelemetry(boost::bind(&MDC2250::applyTelemetryProfile,this,_1)),
+      keepalive(boost::bind(static_cast<bool (MDC2250::*)(std::string)>(&MDC2250::sendCommand),this,_1)),
+      controlLoop(boost::bind(&MDC2250::sendMotorCommand,this,_1),
+                  boost::bind(&MDC2250::flushCommands,this)),
+      reflex(boost::bind(&MDC2250::executeFaultRule,this,_1)),
+      trajectory(boost::bind(&MDC2250::sendMotorCommand,this,_1)) {
+    init();
+}
+
+MDC2250::MDC2250(boost::shared_ptr<Transport> transport)
+    : transport(transport),
+      scheduler(boost::bind(&MDC2250::writePort,this,_1)),
+      supervisor(boost::bind(&MDC2250::reconnectLink,this)),
+      adaptiveTelemetry(boost::bind(&MDC2250::applyTelemetryProfile,this,_1)),
+      keepalive(boost::bind(static_cast<bool (MDC2250::*)(std::string)>(&MDC2250::sendCommand),this,_1)),
+      controlLoop(boost::bind(&MDC2250::sendMotorCommand,this,_1),
+                  boost::bind(&MDC2250::flushCommands,this)),
+      reflex(boost::bind(&MDC2250::executeFaultRule,this,_1)),
+      trajectory(boost::bind(&MDC2250::sendMotorCommand,this,_1)) {
+    init();
+}
+
+void MDC2250::init() {
     // Set default callback
-    my_port.setReadCallback(boost::bind(&MDC2250::readDataCallback,this,_1));
+    transport->setReadCallback(boost::bind(&MDC2250::readDataCallback,this,_1,_2));
+    transport->setReadErrorCallback(boost::bind(&MDC2250::readErrorCallback,this,_1));
     // create map for parsing queries
-    queryMap=create_query_names();
-    configMap=create_config_names();
-    queryCallback=defaultRuntimeQueryCallback;
     configCallback=defaultConfigCallback;
+    odometryCallback=defaultOdometryCallback;
+    odometryEnabled=false;
+    clockSyncEnabled=false;
+    adaptiveTelemetryEnabled=false;
+    ackCount=0;
+    ackAccepted=false;
+    scriptLoading=false;
+    scriptInterrupted=false;
+    lastVariableQuery=0;
+    lastReadTime=0;
+    std::memset(&curStatus,0,sizeof(curStatus));
 }
 
 MDC2250::~MDC2250() {
@@ -83,59 +85,85 @@ MDC2250::~MDC2250() {
 }
 
 bool MDC2250::connect(std::string port) {
+    return connect(port,LinkOptions());
+}
+
+bool MDC2250::connect(std::string port, const LinkOptions &options) {
+    portName=port;
     try {
-        // configure and open serial port
-        my_port.setPort(port);
-        my_port.setBaudrate(115200);
-        my_port.open();
-        my_port.setTimeoutMilliseconds(50);
-
-        // make sure port opened
-        if (!my_port.isOpen()) {
-            std::cout << "MDC2250: Serial port failed to open." << std::endl;
-            return false;
-        }
+        linkInfo=LinkInfo();
+        linkInfo.usbCdc=options.detectUsb&&isUsbCdcPort(port);
+
+        // try the fastest rate first, a USB CDC port ignores the rate
+        std::vector<unsigned long> baudrates=options.baudrates;
+        if (baudrates.empty())
+            baudrates.push_back(115200);
+        std::sort(baudrates.begin(),baudrates.end(),std::greater<unsigned long>());
+        if (linkInfo.usbCdc)
+            baudrates.resize(1);
+
+        std::string modelID;
+        bool found=false;
+        for (size_t i=0; (i<baudrates.size())&&!found; i++) {
+            // a rate the driver rejects only rules out that rate
+            try {
+                // configure and open serial port
+                transport->setBaudrate(baudrates[i]);
+                transport->open(port);
+                transport->setTimeoutMilliseconds(50);
+
+                // make sure port opened
+                if (!transport->isOpen()) {
+                    std::cout << "MDC2250: Serial port failed to open at " << baudrates[i]
+                              << " baud." << std::endl;
+                    continue;
+                }
 
-        clearBufferHistory();
-        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
-        // poor man's flush
-        my_port.read(10000);
-        // make sure a mdc2250 is present on this port by asking for model number
-        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
-        my_port.write("\r?TRN\r"); // request model number
-
-        // wait for return from serial port
-        std::string result = my_port.read(30);
-        // see if I got a valid response
-        // response should look like 'TRN=RCB500:HDC2450'
-        int pos1=result.find("TRN=");
-        int pos2=result.find(":");
-        if ((pos1>=0)&&(pos2>0)) {
-            std::string unitID, modelID;
-            unitID=result.substr(pos1+4,pos2-(pos1+4));
-            modelID=result.substr(pos2+1,result.length()-pos2-2);
-            std::cout << "Found Roboteq controller. Model: " << modelID << " Unit ID: " << unitID << std::endl;
-            // compare model ID to mdc2250
-            if (modelID.find("MDC2250")==std::string::npos) {
-                std::cout << "Controller model is not supported." << std::endl;
-                my_port.close();
-                return false;
+                found=handshake(modelID);
+            } catch (std::exception &e) {
+                std::cout << "MDC2250: Failed to connect at " << baudrates[i] << " baud: "
+                          << e.what() << std::endl;
+            }
+            if (!found) {
+                try {
+                    transport->close();
+                } catch (std::exception &e) {
+                    // the port never opened
+                }
             }
-        } else {
+        }
+        if (!found) {
             std::cout << "Roboteq controller not found." << std::endl;
-            my_port.close();
+            return false;
+        }
+        linkInfo.baudrate=transport->getBaudrate();
+
+        // compare model ID to mdc2250
+        if (modelID.find("MDC2250")==std::string::npos) {
+            std::cout << "Controller model is not supported." << std::endl;
+            transport->close();
             return false;
         }
 
         // read firmware ID (FID)
         boost::this_thread::sleep(boost::posix_time::milliseconds(10));
-        my_port.write("\r?FID\r"); // request model number
-        result = my_port.read(100);
+        transport->write("\r?FID\r"); // request model number
+        std::string result = transport->read(100);
         if (result.length()>10){
             std::cout << "Firmare ID: " << result.substr(10,result.length()-9) << std::endl;
         }
 
-        my_port.setTimeoutMilliseconds(25);
+        if (options.probe) {
+            if (!probeLink(*transport,options.probeRoundTrips,options.probeBurst,linkInfo))
+                std::cout << "MDC2250: Link probe did not complete." << std::endl;
+            std::cout << "Link: " << linkInfo.baudrate << " baud"
+                      << (linkInfo.usbCdc ? " (USB CDC)" : "")
+                      << ", round trip " << linkInfo.rttMean*1000.0 << " ms"
+                      << ", " << linkInfo.bytesPerSecond << " bytes/s" << std::endl;
+        }
+
+        transport->setTimeoutMilliseconds(25);
+        scheduler.start(schedulerOptions);
     } catch (std::exception &e) {
         std::cout << "Failed to connect to MDC2250: " << e.what() << std::endl;
         return false;
@@ -144,8 +172,113 @@ bool MDC2250::connect(std::string port) {
     return true;
 }
 
+bool MDC2250::handshake(std::string &model) {
+    // stop any query history, without forgetting the recorded telemetry
+    transport->write("# C\r");
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    // poor man's flush
+    transport->read(10000);
+    // make sure a mdc2250 is present on this port by asking for model number
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    transport->write("\r?TRN\r"); // request model number
+
+    // wait for return from serial port
+    std::string result = transport->read(30);
+    // see if I got a valid response
+    // response should look like 'TRN=RCB500:HDC2450'
+    size_t pos1=result.find("TRN=");
+    size_t pos2=result.find(":",pos1);
+    if ((pos1==std::string::npos)||(pos2==std::string::npos))
+        return false;
+
+    std::string unitID=result.substr(pos1+4,pos2-(pos1+4));
+    model=result.substr(pos2+1,result.length()-pos2-2);
+    std::cout << "Found Roboteq controller. Model: " << model << " Unit ID: " << unitID << std::endl;
+    return true;
+}
+
 void MDC2250::disconnect() {
-    my_port.close();
+    supervisor.stop();
+    adaptiveTelemetry.stop();
+    adaptiveTelemetryEnabled=false;
+    trajectory.stop();
+    controlLoop.stop();
+    keepalive.stop();
+    scheduler.stop();
+    transport->close();
+}
+
+bool MDC2250::reconnectLink() {
+    if (portName.empty())
+        return false;
+    // wait for senders that checked isReconnecting before it was set,
+    // later ones see it and are refused
+    {
+        boost::unique_lock<boost::shared_mutex> lock(sendMutex);
+    }
+    // writes go straight to the port while the scheduler is stopped
+    scheduler.stop();
+    try {
+        transport->stopContinuousRead();
+        transport->close();
+    } catch (std::exception &e) {
+        // the port is already gone
+    }
+    readCarry.clear();
+
+    try {
+        transport->open(portName);
+        if (!transport->isOpen())
+            return false;
+        // shorter timeouts than connect, the controller is known to be there
+        transport->setTimeoutMilliseconds(20);
+        std::string modelID;
+        if (!handshake(modelID)) {
+            transport->close();
+            return false;
+        }
+        transport->setTimeoutMilliseconds(25);
+    } catch (std::exception &e) {
+        std::cout << "Failed to reconnect to MDC2250: " << e.what() << std::endl;
+        return false;
+    }
+    // the controller may have been reset, its counters and outputs with it,
+    // and echoes of frames sent before the loss will not come
+    {
+        boost::mutex::scoped_lock lock(odometryMutex);
+        odometry.notifyCounterReset();
+    }
+    batcher.reset();
+    scheduler.start(schedulerOptions);
+
+    SessionState restore;
+    {
+        boost::mutex::scoped_lock lock(sessionMutex);
+        restore=session;
+    }
+    // sendCommand refuses commands until the reconnect is over
+    std::vector<std::string> commands=restore.commands();
+    for (size_t i=0; i<commands.size(); i++)
+        scheduler.send(commands[i],classifyCommand(commands[i]));
+    if (restore.continuousRead)
+        transport->startContinuousRead();
+    return true;
+}
+
+void MDC2250::enableSupervisor(const SupervisorOptions &options) {
+    supervisor.start(options);
+}
+
+void MDC2250::disableSupervisor() {
+    supervisor.stop();
+}
+
+void MDC2250::setRecoveryCallback(ConnectionSupervisor::RecoveryCallback callback) {
+    supervisor.setRecoveryCallback(callback);
+}
+
+SupervisorStats MDC2250::getSupervisorStats() {
+    return supervisor.getStats();
 }
 
 // TODO: add ability to give read_until char to continuous read
@@ -153,274 +286,250 @@ void MDC2250::setTelemetryString(std::string queries, long period) {
     std::stringstream cmd;
     cmd << "^TELS \"" << queries << ":# " << period << "\"\r";
     sendCommand(cmd.str());
+    double seconds=(queries.empty()||(period<=0)) ? 0.0 : period/1000.0;
+    supervisor.setTelemetryPeriod(seconds);
+    clockSync.setTelemetryPeriod(seconds);
+    boost::mutex::scoped_lock lock(sessionMutex);
+    session.telemetry=cmd.str();
+    session.telemetryPeriod=seconds;
 }
 
-void MDC2250::readDataCallback(std::string readData) {
-    // split string on carriage returns '\r'
-    std::vector< std::string > splitVec; // holds results
-    boost::algorithm::split( splitVec, readData, boost::algorithm::is_any_of("\r"), boost::algorithm::token_compress_on );
-
-    // loop through each message and parse it
-    BOOST_FOREACH(std::string packet, splitVec)
-    {
-        if (packet.length()>1)
-            parsePacket(packet);
-    }
+void MDC2250::enableAdaptiveTelemetry(const AdaptiveTelemetryOptions &options) {
+    // prefer the measured throughput, a serial byte takes ten bit times
+    double capacity=linkInfo.bytesPerSecond;
+    if ((capacity<=0)&&!linkInfo.usbCdc)
+        capacity=linkInfo.baudrate/10.0;
+    adaptiveTelemetryEnabled=true;
+    adaptiveTelemetry.start(options,capacity);
 }
 
-void MDC2250::parsePacket(std::string packet) {
-    // possible data:
-    // 1) command echo
-    // 2) command acknowledgement (+ or -)
-    // 3) query result
-    // 4) ...
-    //std::cout << "Parsing: " << packet << std::endl;
-    runtimeQuery queryType;
-    ConfigItem configType;
-    // see if this is an echo of a command or query request
-    try {
-        int result = packet.find_first_of("!?%~^#");
-        if (result!=std::string::npos) {
-            //std::cout << "not processing" << std::endl;
-            // echo of sent data - don't process
-            return;
-        }
-
-        // check for command ack/nack
-        if (packet.find_first_of("+-")==0) {
-            // ack or nack - process
-            if (packet.find("+"))
-                std::cout << "Command acknowledged." << std::endl;
-            if (packet.find("-"))
-                std::cout << "Incorrect command received." << std::endl;
-            return;
-        }
+void MDC2250::disableAdaptiveTelemetry() {
+    adaptiveTelemetry.stop();
+    adaptiveTelemetryEnabled=false;
+}
 
-        // split on equal sign
-        std::vector< std::string > splitVec; // holds results
-        boost::algorithm::split( splitVec, packet, boost::algorithm::is_any_of("=:"), boost::algorithm::token_compress_on );
+AdaptiveTelemetryStats MDC2250::getAdaptiveTelemetryStats() {
+    return adaptiveTelemetry.getStats();
+}
 
-        if (splitVec.size()<2) {
-            std::cout << "Incorrectly formed query response: " << packet << std::endl;
-            return;
-        }
+void MDC2250::applyTelemetryProfile(const TelemetryProfile &profile) {
+    setTelemetryString(profile.queries,profile.period);
+}
 
+/*!
+ * Forwards decoded frames to the MDC2250 callbacks, on the read thread.
+ */
+struct MDC2250::PacketHandler {
+    MDC2250 &owner;
+    PacketHandler(MDC2250 &owner) : owner(owner) {}
 
-        double temp;
-        bool queryFound=true;
-        queryType=queryMap[splitVec[0]];
-        // switch on the first
-        switch (queryType) {
-            case _MOTAMPS:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> temp;
-                curStatus.M1_amps=temp/10.0;
-                std::istringstream ( splitVec[2] ) >> temp;
-                curStatus.M2_amps=temp/10.0;
-                break;
-            case _MOTCMD:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> curStatus.M1_cmd;
-                std::istringstream ( splitVec[2] ) >> curStatus.M2_cmd;
-                break;
-            case _MOTPWR:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _ABSPEED:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> curStatus.E1_rpm;
-                std::istringstream ( splitVec[2] ) >> curStatus.E2_rpm;
-                break;
-            case _ABCNTR:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> curStatus.E1_count;
-                std::istringstream ( splitVec[2] ) >> curStatus.E2_count;
-                break;
-            case _BLCNTR:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _RELSPEED:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _RELCNTR:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> curStatus.E1_rel_count;
-                std::istringstream ( splitVec[2] ) >> curStatus.E2_rel_count;
-                break;
-            case _BLRCNTR:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _BLSPEED:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _BLRSPEED:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _BATAMPS:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> temp;
-                curStatus.B1_amps=temp/10.0;
-                std::istringstream ( splitVec[2] ) >> temp;
-                curStatus.B2_amps=temp/10.0;
-                break;
-            case _VOLTS:
-                if (splitVec.size()<4) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> temp;
-                curStatus.driverVoltage=temp/10.0;
-                std::istringstream ( splitVec[2] ) >> temp;
-                curStatus.batVoltage=temp/10.0;
-                std::istringstream ( splitVec[3] ) >> curStatus.fiveVVoltage;
-                break;
-            case _DIGIN:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _DIN:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _ANAIN:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _PLSIN:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _TEMP:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _FEEDBK:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _STFLAG:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _FLTFLAG:
-                if (splitVec.size()<2) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                int flag;
-                std::istringstream ( splitVec[1] ) >> flag;
-                // parse bits of fault flag
-                curStatus.overheat=(flag&0x01)>0;
-                curStatus.overvoltage=(flag&0x02)>0;
-                curStatus.undervoltage=(flag&0x04)>0;
-                curStatus.shortCircuit=(flag&0x08)>0;
-                curStatus.ESTOP=(flag&0x10)>0;
-                curStatus.sepexFault=(flag&0x20)>0;
-                curStatus.EEPROMFault=(flag&0x40)>0;
-                curStatus.configFault=(flag&0x80)>0;
-                break;
-            case _DIGOUT:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _LPERR:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _CMDSER:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _CMDANA:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _CMDPLS:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _TIME:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            case _LOCKED:
-                std::cout << "Query not yet supported." << std::endl;
-                break;
-            default:
-            std::cout << "Unrecognized query response: " << splitVec[0] << std::endl;
-                queryFound=false;
-                break;
+    void onQuery(const mdc2250_raw_status &status, runtimeQuery query,
+                 const long *values, int count) {
+        owner.handleQuery(query,values,count);
+    }
+    void onConfig(long value1, long value2, ConfigItem item) {
+        owner.configCallback(value1,value2,item);
+    }
+    void onAck(bool accepted) {
+        trace::instant(accepted ? "ack" : "nak");
+        if (!accepted)
+            std::cout << "Incorrect command received." << std::endl;
+        boost::mutex::scoped_lock lock(owner.ackMutex);
+        owner.ackCount++;
+        owner.ackAccepted=accepted;
+        owner.ackCondition.notify_all();
+    }
+    void onEcho(const char *begin, const char *end) {
+        // echo of sent data - don't process
+        trace::instant("echo",begin,end);
+        // remember which variable the next ?VAR response belongs to
+        if ((end-begin>=4)&&(std::memcmp(begin,"?VAR",4)==0))
+            owner.lastVariableQuery=std::atoi(std::string(begin+4,end).c_str());
+        // counter samples after this echo were taken after the counter load
+        static const char load[]="!C ";
+        if (std::search(begin,end,load,load+3)!=end) {
+            boost::mutex::scoped_lock lock(owner.odometryMutex);
+            owner.odometry.notifyCounterReset();
         }
-
-        if (queryFound) {
-            // call query callback
-            queryCallback(curStatus,queryType);
+        // ?DO replies after the echo of a flushed frame reflect its outputs
+        static const char outputs[]="!D";
+        if (std::search(begin,end,outputs,outputs+2)!=end)
+            owner.batcher.outputsEchoed(begin,end);
+    }
+    void onError(const char *reason, const char *begin, const char *end) {
+        // the controller may echo script records while loading
+        if (owner.scriptLoading.load()&&(*begin==':'))
             return;
-        }
-
-        // if it was not a query see if it was a config item
-        bool configFound=true;
-        long value1=-1;
-        long value2=-1;
-        configType=configMap[splitVec[0]];
-        switch (configType) {
-            case _EPPR:
-                if (splitVec.size()<3) {
-                    std::cout << "Incorrectly formed query response: " << packet << std::endl;
-                    return;
-                }
-                std::istringstream ( splitVec[1] ) >> value1;
-                std::istringstream ( splitVec[2] ) >> value2;
-                break;
-            default:
-                break;
-        }
+        std::cout << reason << ": " << std::string(begin,end) << std::endl;
+    }
+};
+
+void MDC2250::readDataCallback(const char *data, size_t length) {
+    // all packets in this read share its arrival time
+    lastReadTime=monotonicTime();
+    supervisor.dataReceived(lastReadTime);
+    adaptiveTelemetry.bytesReceived(length);
+    capture.write(lastReadTime,data,length);
+    // the transport owns the read thread, name it on its first read
+    if (boost::this_thread::get_id()!=readThread) {
+        readThread=boost::this_thread::get_id();
+        trace::setThreadName("read");
+    }
+    trace::Span span("read",(long)length);
+
+    // packets may be split across reads, keep the partial one for next time
+    PacketHandler handler(*this);
+    if (!readCarry.empty()) {
+        readCarry.append(data,length);
+        trace::Span decodeSpan("decode",(long)readCarry.length());
+        size_t consumed=decodeBuffer(readCarry.data(),readCarry.length(),curStatus,handler);
+        readCarry.erase(0,consumed);
+        return;
+    }
+    trace::Span decodeSpan("decode",(long)length);
+    size_t consumed=decodeBuffer(data,length,curStatus,handler);
+    if (consumed<length)
+        readCarry.assign(data+consumed,length-consumed);
+}
 
-        if (configFound) {
-            configCallback(value1, value2, configType);
-            return;
-        }
+void MDC2250::readErrorCallback(const std::string &reason) {
+    std::cout << "Failed to read from MDC2250: " << reason << std::endl;
+    supervisor.linkError();
+}
 
-    } catch (std::exception &e) {
-        std::cout << "Error parsing packet: " << e.what() << std::endl;
-        return;
+void MDC2250::handleQuery(runtimeQuery query, const long *values, int count) {
+    trace::Span span("query",query);
+    switch (query) {
+        case _ABCNTR:
+            if (odometryEnabled)
+                updateOdometry(true,values[0],values[1]);
+            break;
+        case _RELCNTR:
+            if (odometryEnabled)
+                updateOdometry(false,values[0],values[1]);
+            break;
+        case _FLTFLAG:
+            // react to fault transitions before anything else sees them
+            reflex.update(values[0],lastReadTime);
+            break;
+        case _TIME:
+            if (clockSyncEnabled&&(count>0))
+                clockSync.update(values[0],lastReadTime);
+            break;
+        case _ABSPEED:
+            if (adaptiveTelemetryEnabled&&(count>1))
+                adaptiveTelemetry.speedUpdate(values[0],values[1]);
+            break;
+        case _DIGOUT:
+            if (count>0)
+                batcher.outputsRead(values[0]);
+            break;
+        case _VAR:
+            updateUserVariables(values,count);
+            break;
+        default:
+            break;
     }
 
+    if (clockSyncEnabled&&clockSync.isValid())
+        curStatus.time=clockSync.toControllerTime(lastReadTime);
+    else
+        curStatus.time=lastReadTime;
+
+    // call query callbacks, converting units only if someone wants them
+    if (rawQueryCallback) {
+        trace::Span callbackSpan("rawQueryCallback",query);
+        rawQueryCallback(curStatus,query);
+    }
+    if (queryCallback) {
+        trace::Span callbackSpan("queryCallback",query);
+        queryCallback(curStatus.toStatus(),query);
+    }
+    trace::Span publishSpan("publish",query);
+    dispatcher.publish(curStatus,query);
+    boost::mutex::scoped_lock lock(publisherMutex);
+    publisher.publish(curStatus,query,lastReadTime);
 }
 
-bool MDC2250::waitForAck() {
-    // TODO: implement this!
-    // get lock on ackReceived
-    // MUTEX HERE
-    ackReceived=false;
-    // wait for condition variable for a set time
+bool MDC2250::sendAndWaitForAck(const std::string &cmd, double timeout) {
+    boost::mutex::scoped_lock lock(ackMutex);
+    unsigned long expected=ackCount+1;
+    lock.unlock();
+    // true only means queued, the acknowledgement tells whether it arrived
+    if (!scheduleCommand(cmd,commandpriority::_CONFIG))
+        return false;
+    lock.lock();
+    boost::system_time deadline=boost::get_system_time()
+        +boost::posix_time::microseconds((long)(timeout*1.0e6));
+    while (ackCount<expected)
+        if (!ackCondition.timed_wait(lock,deadline))
+            return false;
+    return ackAccepted;
+}
 
-    return false;
+bool MDC2250::waitForAckSilence(double quiet, double timeout) {
+    boost::system_time deadline=boost::get_system_time()
+        +boost::posix_time::microseconds((long)(timeout*1.0e6));
+    boost::mutex::scoped_lock lock(ackMutex);
+    while (true) {
+        unsigned long count=ackCount;
+        boost::system_time quietEnd=boost::get_system_time()
+            +boost::posix_time::microseconds((long)(quiet*1.0e6));
+        if (quietEnd>deadline)
+            return false;
+        while (ackCount==count)
+            if (!ackCondition.timed_wait(lock,quietEnd))
+                return true;
+    }
 }
 
 void MDC2250::startContinuousReading() {
     std::cout << "Starting continuous read." << std::endl;
-    my_port.startContinuousRead(50);
+    transport->startContinuousRead();
+    boost::mutex::scoped_lock lock(sessionMutex);
+    session.continuousRead=true;
 }
 
 void MDC2250::stopContinuousReading() {
-    my_port.stopContinuousRead();
+    transport->stopContinuousRead();
+    boost::mutex::scoped_lock lock(sessionMutex);
+    session.continuousRead=false;
 }
 
 void MDC2250::setRuntimeQueryCallback(RuntimeQueryCallback callback) {
     queryCallback=callback;
 }
 
+void MDC2250::setRawQueryCallback(RawQueryCallback callback) {
+    rawQueryCallback=callback;
+}
+
+int MDC2250::addRawQuerySubscriber(RawQueryCallback callback, const SubscriberOptions &options) {
+    return dispatcher.add(callback,options);
+}
+
+int MDC2250::addQuerySubscriber(RuntimeQueryCallback callback, const SubscriberOptions &options) {
+    return dispatcher.add(boost::bind(&callConverted,callback,_1,_2),options);
+}
+
+void MDC2250::removeQuerySubscriber(int id) {
+    dispatcher.remove(id);
+}
+
+SubscriberStats MDC2250::getSubscriberStats(int id) {
+    return dispatcher.getStats(id);
+}
+
 
 /***** Command Methods *****/
 
 void MDC2250::clearBufferHistory() {
     sendCommand("# C\r");
+    supervisor.setTelemetryPeriod(0);
+    clockSync.setTelemetryPeriod(0);
+    boost::mutex::scoped_lock lock(sessionMutex);
+    session.telemetry.clear();
+    session.telemetryPeriod=0;
 }
 
 void MDC2250::sendQueryHistory(long period) {
@@ -430,7 +539,9 @@ void MDC2250::sendQueryHistory(long period) {
 }
 
 void MDC2250::setAcceleration(int channel, int acceleration) {
-
+    std::stringstream cmd;
+    cmd << "!AC " << channel << " " << acceleration << "\r";
+    sendCommand(cmd.str());
 }
 
 void MDC2250::getAcceleration(int channel, int acceleration) {
@@ -438,35 +549,215 @@ void MDC2250::getAcceleration(int channel, int acceleration) {
 }
 
 void MDC2250::ESTOP() {
-    sendCommand("!EX\r");
+    sendEmergencyStop();
 }
 
 void MDC2250::ClearESTOP() {
-    sendCommand("!MG\r");
+    sendCommand("!MG\r",commandpriority::_SAFETY);
 }
 
-void MDC2250::motorCmd(int channel, int command) {
+bool MDC2250::motorCmd(int channel, int command) {
     std::stringstream cmd;
     cmd << "!G " << channel << " " << command << "\r";
-    sendCommand(cmd.str());
+    bool result=sendMotorCommand(cmd.str());
+    adaptiveTelemetry.commandSent(channel,command);
+    return result;
 }
 
-void MDC2250::multiMotorCmd(int cmd1, int cmd2) {
+bool MDC2250::multiMotorCmd(int cmd1, int cmd2) {
+    adaptiveTelemetry.commandSent(1,cmd1);
+    adaptiveTelemetry.commandSent(2,cmd2);
+    if (controlLoop.isRunning()) {
+        controlLoop.publish(cmd1,cmd2);
+        return true;
+    }
     std::stringstream cmd;
     cmd << "!M " << cmd1 << " " << cmd2 << "\r";
-    sendCommand(cmd.str());
+    return sendMotorCommand(cmd.str());
+}
+
+bool MDC2250::setPosition(int channel, int position) {
+    std::stringstream cmd;
+    cmd << "!P " << channel << " " << position << "\r";
+    return sendMotorCommand(cmd.str());
+}
+
+bool MDC2250::setVelocity(int channel, int velocity) {
+    std::stringstream cmd;
+    cmd << "!S " << channel << " " << velocity << "\r";
+    return sendMotorCommand(cmd.str());
+}
+
+bool MDC2250::setEncoderCounter(int channel, int value) {
+    std::stringstream cmd;
+    cmd << "!C " << channel << " " << value << "\r";
+    // the odometry takes a new baseline when the controller echoes it
+    return sendCommand(cmd.str());
+}
+
+bool MDC2250::sendCommand(commanditem::CommandItem item, long arg1, long arg2) {
+    switch (item) {
+        case commanditem::_GO:
+            return motorCmd(arg1,arg2);
+        case commanditem::_MOTCMD:
+            return multiMotorCmd(arg1,arg2);
+        case commanditem::_MOTPOS:
+            return setPosition(arg1,arg2);
+        case commanditem::_MOTVEL:
+            return setVelocity(arg1,arg2);
+        case commanditem::_SENCNTR:
+            return setEncoderCounter(arg1,arg2);
+        case commanditem::_DOUT:
+            setDigitalOutputs(arg1);
+            return flushCommands();
+        case commanditem::_DSET:
+        case commanditem::_DRES:
+            if (!setDigitalOutput(arg1,item==commanditem::_DSET))
+                return false;
+            return flushCommands();
+        case commanditem::_VAR:
+            setUserVariable(arg1,arg2);
+            return flushCommands();
+        default:
+            break;
+    }
+    std::string cmd=formatCommand(item,arg1,arg2);
+    if (cmd.empty())
+        return false;
+    return sendCommand(cmd+"\r");
+}
+
+bool MDC2250::setDigitalOutput(int output, bool state) {
+    return batcher.setOutput(output,state);
+}
+
+void MDC2250::setDigitalOutputs(int mask) {
+    batcher.setOutputs(mask);
+}
+
+int MDC2250::getDigitalOutputs() {
+    return batcher.getOutputs();
 }
 
-void MDC2250::setPosition(int channel, int position) {
+void MDC2250::setUserVariable(int index, long value) {
+    batcher.setVariable(index,value);
+}
+
+bool MDC2250::flushCommands() {
+    CommandBatcher::Taken taken;
+    std::string frames=batcher.take(taken);
+    if (frames.empty())
+        return true;
+    // keep refused writes for the next flush, e.g. after a reconnect
+    if (!sendCommand(frames)) {
+        batcher.restore(taken);
+        return false;
+    }
+    return true;
+}
+
+/***** MicroBasic Methods *****/
+
+bool MDC2250::uploadScript(const std::string &path) {
+    std::vector<std::string> records;
+    if (!loadScriptHex(path,records))
+        return false;
+    return uploadScript(records);
+}
+
+bool MDC2250::uploadScript(const std::vector<std::string> &records) {
+    {
+        boost::mutex::scoped_lock lock(sessionMutex);
+        if (!session.continuousRead) {
+            std::cout << "MicroBasic: Start continuous reading before uploading a script." << std::endl;
+            return false;
+        }
+    }
+    // acknowledgements are matched by count, so nothing else may be sent
+    if (controlLoop.isRunning()||trajectory.isRunning()||keepalive.isRunning()
+        ||adaptiveTelemetry.isRunning()) {
+        std::cout << "MicroBasic: Stop the control loop, trajectory, watchdog keepalive "
+                  << "and adaptive telemetry before uploading a script." << std::endl;
+        return false;
+    }
+    if (scriptLoading.exchange(true)) {
+        std::cout << "MicroBasic: A script is already being uploaded." << std::endl;
+        return false;
+    }
+    scriptInterrupted=false;
+
+    // from here on sendCommand refuses everything but safety commands, but
+    // commands queued before may still be written and acknowledged; let
+    // them settle so their acknowledgements are not counted for the upload
+    if (!scheduler.waitUntilWritten(0.5)||!waitForAckSilence(0.05,1.0)) {
+        scriptLoading=false;
+        std::cout << "MicroBasic: Earlier commands are still being acknowledged." << std::endl;
+        return false;
+    }
+    std::stringstream stop;
+    stop << "!R " << scriptcommand::_STOP << "\r";
+    bool stopped=sendAndWaitForAck(stop.str(),0.5);
+    std::stringstream cmd;
+    cmd << "%SLD " << SCRIPT_LOAD_KEY << "\r";
+    bool result=stopped&&sendAndWaitForAck(cmd.str(),0.5);
+    size_t sent=0;
+    for (; result&&(sent<records.size()); sent++)
+        result=sendAndWaitForAck(records[sent]+"\r",0.5);
+    scriptLoading=false;
+
+    if (scriptInterrupted.load()) {
+        std::cout << "MicroBasic: A safety command was sent during the upload, "
+                  << "the acknowledgements can not be trusted." << std::endl;
+        return false;
+    }
+    if (!stopped) {
+        std::cout << "MicroBasic: Stopping the running script was not acknowledged." << std::endl;
+        return false;
+    }
+    if (!result&&(sent==0))
+        std::cout << "MicroBasic: Script load mode was not acknowledged." << std::endl;
+    else if (!result)
+        std::cout << "MicroBasic: Record " << sent << " of " << records.size()
+                  << " was not acknowledged." << std::endl;
+    return result;
+}
 
+void MDC2250::startScript(bool restart) {
+    std::stringstream cmd;
+    cmd << "!R " << (restart ? scriptcommand::_RESTART : scriptcommand::_RUN) << "\r";
+    sendCommand(cmd.str());
 }
 
-void MDC2250::setVelocity(int channel, int velocity) {
+void MDC2250::stopScript() {
+    std::stringstream cmd;
+    cmd << "!R " << scriptcommand::_STOP << "\r";
+    sendCommand(cmd.str());
+}
 
+void MDC2250::requestUserVariable(int index) {
+    std::stringstream cmd;
+    cmd << "?VAR " << index << "\r";
+    sendCommand(cmd.str());
 }
 
-void MDC2250::setEncoderCounter(int channel, int value) {
+bool MDC2250::getUserVariable(int index, long &value) {
+    boost::mutex::scoped_lock lock(variableMutex);
+    std::map<int,long>::const_iterator it=userVariables.find(index);
+    if (it==userVariables.end())
+        return false;
+    value=it->second;
+    return true;
+}
 
+void MDC2250::updateUserVariables(const long *values, int count) {
+    // ?VAR n answers one value, ?VAR answers the variables from 1 on
+    int first=(lastVariableQuery>0) ? lastVariableQuery : 1;
+    if (lastVariableQuery>0)
+        count=std::min(count,1);
+    lastVariableQuery=0;
+    boost::mutex::scoped_lock lock(variableMutex);
+    for (int i=0; i<count; i++)
+        userVariables[first+i]=values[i];
 }
 
 inline void MDC2250::reset() {
@@ -482,7 +773,43 @@ inline void MDC2250::saveEEPROM() {
 }
 
 void MDC2250::setWatchdogTimer(long ms) {
+    setWatchdogTimer(ms,KeepaliveOptions());
+}
+
+void MDC2250::setWatchdogTimer(long ms, const KeepaliveOptions &options) {
+    // check range: 0 (disabled) to 65000
+    if ((ms<0)||(ms>65000)) {
+        std::cout << "Invalid watchdog period. Not set." << std::endl;
+        return;
+    }
+    std::stringstream cmd;
+    cmd << "^RWD " << ms << "\r";
+    sendCommand(cmd.str());
+    {
+        boost::mutex::scoped_lock lock(sessionMutex);
+        session.watchdog=cmd.str();
+    }
+
+    if ((ms>0)&&options.enabled)
+        keepalive.start(ms,options);
+    else
+        keepalive.stop();
+}
+
+KeepaliveStats MDC2250::getKeepaliveStats() {
+    return keepalive.getStats();
+}
+
+void MDC2250::startControlLoop(const ControlLoopOptions &options) {
+    controlLoop.start(options);
+}
 
+void MDC2250::stopControlLoop() {
+    controlLoop.stop();
+}
+
+ControlLoopStats MDC2250::getControlLoopStats() {
+    return controlLoop.getStats();
 }
 
 void MDC2250::setEncoderPPR(int channel, int ppr=100) {
@@ -494,11 +821,18 @@ void MDC2250::setEncoderPPR(int channel, int ppr=100) {
     std::stringstream cmd;
     cmd << "^EPPR " << channel << " " << ppr << "\r";
     sendCommand(cmd.str());
+    if ((channel==1)||(channel==2)) {
+        boost::mutex::scoped_lock lock(sessionMutex);
+        session.encoderPPR[channel-1]=cmd.str();
+    }
+    trajectory.setEncoderPPR(channel,ppr);
+    boost::mutex::scoped_lock lock(odometryMutex);
+    odometry.setEncoderPPR(channel,ppr);
 }
 
 long MDC2250::getEncoderPPR() {
     // see if continuous read is on
-//    bool wasReading=my_port.isContinuouslyReading();
+//    bool wasReading=transport->isContinuouslyReading();
 //    if (wasReading)
 //        stopContinuousReading();
 
@@ -522,6 +856,10 @@ void MDC2250::setMaxRPM(int channel, int mrpm=3000) {
     std::stringstream cmd;
     cmd << "^MRPM " << channel << " " << mrpm << "\r";
     sendCommand(cmd.str());
+    if ((channel==1)||(channel==2)) {
+        boost::mutex::scoped_lock lock(sessionMutex);
+        session.maxRPM[channel-1]=cmd.str();
+    }
 }
 
 long MDC2250::getMaxRPM() {
@@ -529,21 +867,216 @@ long MDC2250::getMaxRPM() {
 }
 
 bool MDC2250::sendCommand(std::string cmd) {
-    if (!my_port.isOpen())
+    return sendCommand(cmd,classifyCommand(cmd));
+}
+
+bool MDC2250::sendCommand(std::string cmd, commandpriority::CommandPriority priority) {
+    // a script upload matches acknowledgements by count, only let safety
+    // commands through and have the upload fail on them
+    if (scriptLoading.load()) {
+        if (priority!=commandpriority::_SAFETY)
+            return false;
+        scriptInterrupted=true;
+    }
+    // queued motion commands must not restart the motors after !EX
+    bool stop=(priority==commandpriority::_SAFETY)
+        &&(cmd.compare(std::min(cmd.find_first_not_of("\r"),cmd.length()),3,"!EX")==0);
+    return scheduleCommand(cmd,priority,stop);
+}
+
+bool MDC2250::scheduleCommand(const std::string &cmd, commandpriority::CommandPriority priority,
+                              bool purgeMotion) {
+    trace::Span span("sendCommand",cmd,priority);
+    // the port is being reopened, keep writes away from the handshake; the
+    // lock keeps a reconnect from starting between the check and the send
+    boost::shared_lock<boost::shared_mutex> lock(sendMutex);
+    if (supervisor.isReconnecting()) {
+        supervisor.commandDropped();
         return false;
-    try {
-        if (my_port.write(cmd)==cmd.length()) {
-            // TODO: wait for ack??
-            return true;
-        } else
+    }
+    return scheduler.send(cmd,priority,purgeMotion);
+}
+
+void MDC2250::startTrajectory(const TrajectoryOptions &options) {
+    trajectory.start(options);
+}
+
+bool MDC2250::appendTrajectory(int channel, const std::vector<TrajectoryPoint> &points) {
+    return trajectory.append(channel,points);
+}
+
+void MDC2250::endTrajectory(int channel) {
+    trajectory.finish(channel);
+}
+
+bool MDC2250::isTrajectoryDone() {
+    return trajectory.isDone();
+}
+
+void MDC2250::stopTrajectory() {
+    trajectory.stop();
+}
+
+TrajectoryStats MDC2250::getTrajectoryStats() {
+    return trajectory.getStats();
+}
+
+int MDC2250::addFaultRule(const FaultRule &rule) {
+    return reflex.addRule(rule);
+}
+
+void MDC2250::clearFaultRules() {
+    reflex.clearRules();
+}
+
+ReflexStats MDC2250::getReflexStats() {
+    return reflex.getStats();
+}
+
+bool MDC2250::executeFaultRule(const FaultRule &rule) {
+    switch (rule.action) {
+        case faultaction::_ESTOP:
+            return sendEmergencyStop();
+        case faultaction::_ZERO_MOTORS:
+            // keep the control loop and keepalive from restoring the old setpoint
+            if (controlLoop.isRunning())
+                controlLoop.publish(0,0);
+            keepalive.commandSent("!M 0 0\r");
+            return sendStopCommand("!M 0 0\r");
+        case faultaction::_COMMAND:
+            // a reaction to a fault, queued motion must not undo it
+            return sendStopCommand(rule.command);
+        default:
             return false;
+    }
+}
+
+void MDC2250::setSchedulerOptions(const SchedulerOptions &options) {
+    schedulerOptions=options;
+}
+
+SchedulerStats MDC2250::getSchedulerStats() {
+    return scheduler.getStats();
+}
+
+bool MDC2250::writePort(const std::string &data) {
+    if (!transport->isOpen()) {
+        supervisor.commandDropped();
+        return false;
+    }
+    try {
+        return transport->write(data)==data.length();
     } catch (std::exception &e) {
         std::cout << "Failed to send command: " << e.what() << std::endl;
+        supervisor.linkError();
+        supervisor.commandDropped();
         return false;
     }
 }
 
+bool MDC2250::sendEmergencyStop() {
+    // keep the control loop from restoring the old setpoint after !MG
+    if (controlLoop.isRunning())
+        controlLoop.publish(0,0);
+    // and the keepalive from resending it
+    keepalive.commandSent("!M 0 0\r");
+    return sendStopCommand("!EX\r");
+}
+
+bool MDC2250::sendStopCommand(const std::string &cmd) {
+    // safety commands go out during an upload, but the upload must fail
+    if (scriptLoading.load())
+        scriptInterrupted=true;
+    return scheduleCommand(cmd,commandpriority::_SAFETY,true);
+}
+
+bool MDC2250::sendMotorCommand(std::string cmd) {
+    bool result=sendCommand(cmd);
+    // only keep alive what the controller will get, a refused command
+    // must not be resent once the link or the upload is over
+    if (result)
+        keepalive.commandSent(cmd);
+    return result;
+}
+
 void MDC2250::ClearEncoderCounts() {
+    // the odometry takes a new baseline when the controller echoes it
     sendCommand("\r!C 1 0_!C 2 0\r");
+}
+
+/***** Odometry Methods *****/
+
+void MDC2250::updateOdometry(bool absolute, long value1, long value2) {
+    OdometryState state;
+    {
+        boost::mutex::scoped_lock lock(odometryMutex);
+        // frames decoded from one read share its arrival time, the estimator
+        // measures velocity across the whole read instead of per frame
+        if (absolute)
+            odometry.updateAbsolute(value1,value2,lastReadTime);
+        else
+            odometry.updateRelative(value1,value2,lastReadTime);
+        state=odometry.getState();
+    }
+    // call outside of the lock so the callback may use getOdometry
+    odometryCallback(state);
+}
+
+bool MDC2250::enableOdometry(const OdometryConfig &config) {
+    boost::mutex::scoped_lock lock(odometryMutex);
+    if (!odometry.configure(config)) {
+        std::cout << "Invalid odometry geometry. Not enabled." << std::endl;
+        return false;
+    }
+    odometryEnabled=true;
+    return true;
+}
+
+void MDC2250::disableOdometry() {
+    odometryEnabled=false;
+}
+
+void MDC2250::resetOdometry() {
+    boost::mutex::scoped_lock lock(odometryMutex);
+    odometry.reset();
+}
+
+OdometryState MDC2250::getOdometry() {
+    boost::mutex::scoped_lock lock(odometryMutex);
+    return odometry.getState();
+}
+
+bool MDC2250::enableTelemetryPublisher(std::string name, size_t history) {
+    boost::mutex::scoped_lock lock(publisherMutex);
+    return publisher.open(name,history);
+}
+
+void MDC2250::disableTelemetryPublisher() {
+    boost::mutex::scoped_lock lock(publisherMutex);
+    publisher.close();
+}
+
+bool MDC2250::enableCapture(std::string path) {
+    return capture.open(path);
+}
+
+void MDC2250::disableCapture() {
+    capture.close();
+}
+
+void MDC2250::enableClockSync(const ClockSyncOptions &options) {
+    clockSync.setOptions(options);
+    clockSyncEnabled=true;
+}
+
+void MDC2250::disableClockSync() {
+    clockSyncEnabled=false;
+}
+
+ClockSyncState MDC2250::getClockSyncState() {
+    return clockSync.getState();
+}
 
+void MDC2250::setOdometryCallback(OdometryCallback callback) {
+    odometryCallback=callback;
 }
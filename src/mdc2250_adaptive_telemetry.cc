@@ -0,0 +1,147 @@
+#include "mdc2250/mdc2250_adaptive_telemetry.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <boost/bind.hpp>
+using namespace mdc2250;
+
+/***** AdaptiveTelemetry Class Functions *****/
+
+AdaptiveTelemetry::AdaptiveTelemetry(ApplyFunction applyFunction)
+    : apply(applyFunction), linkCapacity(0), speed(0), speedChange(0),
+      received(0), lastMotion(0), lastChange(0), movingPeriod(0) {
+    command[0]=command[1]=0;
+    lastSpeed[0]=lastSpeed[1]=0;
+    std::memset(&stats,0,sizeof(stats));
+}
+
+AdaptiveTelemetry::~AdaptiveTelemetry() {
+    stop();
+}
+
+void AdaptiveTelemetry::start(const AdaptiveTelemetryOptions &newOptions, double capacity) {
+    stop();
+    options=newOptions;
+    if (options.checkPeriod<=0)
+        options.checkPeriod=0.02;
+    if (options.linkWindow<options.checkPeriod)
+        options.linkWindow=options.checkPeriod;
+    if (options.moving.period<1)
+        options.moving.period=1;
+    if (options.idle.period<options.moving.period)
+        options.idle.period=options.moving.period;
+    linkCapacity=(capacity>0) ? capacity : 0;
+
+    command[0]=command[1]=0;
+    speed=0;
+    speedChange=0;
+    received=0;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        std::memset(&stats,0,sizeof(stats));
+        movingPeriod=options.moving.period;
+        lastMotion=0;
+        applyPlan(monotonicTime());
+    }
+    timer.reset();
+    thread.reset(new boost::thread(boost::bind(&AdaptiveTelemetry::run,this)));
+}
+
+void AdaptiveTelemetry::stop() {
+    if (!thread)
+        return;
+    timer.cancel();
+    thread->join();
+    thread.reset();
+}
+
+bool AdaptiveTelemetry::isRunning() {
+    return thread.get()!=NULL;
+}
+
+void AdaptiveTelemetry::commandSent(int channel, int value) {
+    if ((channel==1)||(channel==2))
+        command[channel-1]=std::abs(value);
+}
+
+void AdaptiveTelemetry::speedUpdate(long rpm1, long rpm2) {
+    long change=std::max(std::labs(rpm1-lastSpeed[0]),std::labs(rpm2-lastSpeed[1]));
+    lastSpeed[0]=rpm1;
+    lastSpeed[1]=rpm2;
+    speed=std::max(std::labs(rpm1),std::labs(rpm2));
+    // only the read thread raises it, a reset lost to the race is harmless
+    if (change>speedChange.load())
+        speedChange=change;
+}
+
+TelemetryProfile AdaptiveTelemetry::getProfile() {
+    boost::mutex::scoped_lock lock(mutex);
+    return profile;
+}
+
+AdaptiveTelemetryStats AdaptiveTelemetry::getStats() {
+    boost::mutex::scoped_lock lock(mutex);
+    return stats;
+}
+
+// must be called with mutex held
+void AdaptiveTelemetry::applyPlan(double now) {
+    if (stats.moving)
+        profile=TelemetryProfile(options.moving.queries,movingPeriod);
+    else
+        profile=options.idle;
+    stats.period=profile.period;
+    lastChange=now;
+    apply(profile);
+}
+
+void AdaptiveTelemetry::run() {
+    double deadline=monotonicTime();
+    double windowStart=deadline;
+    double linkUse=0;
+    while (timer.waitUntil(deadline+=options.checkPeriod)) {
+        double now=monotonicTime();
+
+        // average the received bytes over the link window
+        double elapsed=now-windowStart;
+        windowStart=now;
+        unsigned long bytes=received.exchange(0);
+        if ((linkCapacity>0)&&(elapsed>0)) {
+            double alpha=std::min(1.0,elapsed/options.linkWindow);
+            linkUse+=alpha*(bytes/(elapsed*linkCapacity)-linkUse);
+        }
+
+        bool motion=(std::max(command[0].load(),command[1].load())>options.commandThreshold)
+            ||(speed.load()>options.rpmThreshold)
+            ||(speedChange.exchange(0)>options.rpmThreshold);
+
+        boost::mutex::scoped_lock lock(mutex);
+        stats.linkUse=linkUse;
+        if (motion)
+            lastMotion=now;
+
+        if (motion&&!stats.moving) {
+            // leave standstill at once, the first samples matter most
+            stats.moving=true;
+            stats.switches++;
+            movingPeriod=options.moving.period;
+            applyPlan(now);
+        } else if (!motion&&stats.moving&&(now-lastMotion>=options.holdTime)) {
+            stats.moving=false;
+            stats.switches++;
+            applyPlan(now);
+        } else if (stats.moving&&(linkCapacity>0)&&(options.maxLinkUse>0)
+                   &&(now-lastChange>=options.linkWindow)) {
+            if ((linkUse>options.maxLinkUse)&&(movingPeriod<options.idle.period)) {
+                movingPeriod=std::min(movingPeriod*2,options.idle.period);
+                stats.throttles++;
+                applyPlan(now);
+            } else if ((linkUse<0.5*options.maxLinkUse)&&(movingPeriod>options.moving.period)) {
+                movingPeriod=std::max(movingPeriod/2,options.moving.period);
+                stats.restores++;
+                applyPlan(now);
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#include "mdc2250/mdc2250_capture.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+using namespace mdc2250;
+
+/***** Inline Functions *****/
+
+// Converts a time in seconds to whole microseconds
+inline boost::int64_t toMicroseconds(double time) {
+    return (boost::int64_t)(time*1.0e6+((time<0) ? -0.5 : 0.5));
+}
+
+// Returns the wall clock time in microseconds since 1970
+inline boost::int64_t wallClockMicroseconds() {
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970,1,1));
+    return (boost::posix_time::microsec_clock::universal_time()-epoch).total_microseconds();
+}
+
+/***** CaptureWriter Class Functions *****/
+
+CaptureWriter::CaptureWriter() {
+}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+bool CaptureWriter::open(const std::string &path) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (file.is_open())
+        file.close();
+    file.clear();
+    file.open(path.c_str(),std::ios::out|std::ios::binary|std::ios::trunc);
+    if (!file)
+        return false;
+    CaptureHeader header;
+    header.magic=CAPTURE_MAGIC;
+    header.version=CAPTURE_VERSION;
+    header.monotonicStart=toMicroseconds(monotonicTime());
+    header.wallStart=wallClockMicroseconds();
+    file.write((const char*)&header,sizeof(header));
+    return file.good();
+}
+
+void CaptureWriter::close() {
+    boost::mutex::scoped_lock lock(mutex);
+    if (file.is_open())
+        file.close();
+}
+
+bool CaptureWriter::isOpen() {
+    boost::mutex::scoped_lock lock(mutex);
+    return file.is_open();
+}
+
+void CaptureWriter::write(double time, const char *data, size_t length) {
+    if (length==0)
+        return;
+    CaptureRecord record;
+    record.time=toMicroseconds(time);
+    record.length=(boost::uint32_t)length;
+    record.reserved=0;
+    boost::mutex::scoped_lock lock(mutex);
+    if (!file.is_open())
+        return;
+    file.write((const char*)&record,sizeof(record));
+    file.write(data,length);
+}
+
+/***** Capture Reading *****/
+
+bool mdc2250::readCaptureHeader(std::istream &input, CaptureHeader &header) {
+    if (!input.read((char*)&header,sizeof(header)))
+        return false;
+    return (header.magic==CAPTURE_MAGIC)&&(header.version==CAPTURE_VERSION);
+}
@@ -0,0 +1,146 @@
+#include "mdc2250/mdc2250_clock_sync.h"
+#include <algorithm>
+#include <vector>
+
+using namespace mdc2250;
+
+// ticks needed before the drift is fitted rather than assumed zero
+static const size_t MIN_DRIFT_TICKS = 8;
+
+/***** ClockSync Class Functions *****/
+
+ClockSync::ClockSync(const ClockSyncOptions &options) : options(options), telemetryPeriod(0) {
+    reset();
+}
+
+void ClockSync::setOptions(const ClockSyncOptions &newOptions) {
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        options=newOptions;
+    }
+    reset();
+}
+
+void ClockSync::setTelemetryPeriod(double period) {
+    boost::mutex::scoped_lock lock(mutex);
+    telemetryPeriod=std::max(period,0.0);
+}
+
+void ClockSync::reset() {
+    boost::mutex::scoped_lock lock(mutex);
+    ticks.clear();
+    haveLast=false;
+    lastSeconds=0;
+    lastHost=0.0;
+    baseSeconds=0;
+    baseHost=0.0;
+    intercept=0.0;
+    slope=1.0;
+    state=ClockSyncState();
+}
+
+bool ClockSync::update(long seconds, double hostTime) {
+    boost::mutex::scoped_lock lock(mutex);
+    bool tick=haveLast&&(seconds!=lastSeconds);
+    if (haveLast&&(seconds<lastSeconds)) {
+        // controller clock went backwards, it was restarted or reset
+        ticks.clear();
+        state=ClockSyncState();
+        tick=false;
+    }
+    // a tick after a long silence could have happened anywhere in it
+    double maxGap=options.maxTickGap;
+    if (maxGap<=0)
+        maxGap=(telemetryPeriod>0) ? 1.5*telemetryPeriod+1.0 : 2.0;
+    if (tick&&(hostTime-lastHost>maxGap))
+        tick=false;
+    haveLast=true;
+    lastSeconds=seconds;
+    lastHost=hostTime;
+    if (!tick)
+        return false;
+
+    if (ticks.empty()) {
+        baseSeconds=seconds;
+        baseHost=hostTime;
+    }
+    Tick t;
+    t.seconds=seconds-baseSeconds;
+    t.host=hostTime-baseHost;
+    ticks.push_back(t);
+    while (ticks.size()>(size_t)std::max(options.window,2))
+        ticks.pop_front();
+    fit();
+    return true;
+}
+
+void ClockSync::fit() {
+    if (ticks.size()<MIN_DRIFT_TICKS) {
+        // too short a span to see drift: the offset is the lowest arrival
+        slope=1.0;
+        intercept=ticks[0].host-ticks[0].seconds;
+        for (size_t i=1; i<ticks.size(); i++)
+            intercept=std::min(intercept,ticks[i].host-ticks[i].seconds);
+    } else {
+        // the line through the ticks' lower convex hull that passes
+        // highest at their mean controller time: no tick arrives before
+        // the line, and it hugs the ticks that saw the least delay
+        std::vector<size_t> hull;
+        double mean=0.0;
+        for (size_t i=0; i<ticks.size(); i++) {
+            mean+=ticks[i].seconds;
+            while (hull.size()>=2) {
+                const Tick &p=ticks[hull[hull.size()-2]];
+                const Tick &q=ticks[hull[hull.size()-1]];
+                // drop q if it lies on or above the segment p..i
+                double cross=(q.seconds-p.seconds)*(ticks[i].host-p.host)
+                    -(q.host-p.host)*(ticks[i].seconds-p.seconds);
+                if (cross>0.0)
+                    break;
+                hull.pop_back();
+            }
+            hull.push_back(i);
+        }
+        mean/=ticks.size();
+        for (size_t k=0; k+1<hull.size(); k++) {
+            const Tick &p=ticks[hull[k]];
+            const Tick &q=ticks[hull[k+1]];
+            if ((q.seconds>=mean)||(k+2==hull.size())) {
+                slope=(q.host-p.host)/(q.seconds-p.seconds);
+                intercept=p.host-slope*p.seconds;
+                break;
+            }
+        }
+    }
+
+    // how far the ticks arrive after the line on average
+    double sum=0.0;
+    for (size_t i=0; i<ticks.size(); i++)
+        sum+=ticks[i].host-(intercept+slope*ticks[i].seconds);
+
+    state.valid=true;
+    state.ticks=ticks.size();
+    state.offset=baseHost+intercept-slope*baseSeconds;
+    state.drift=slope-1.0;
+    state.jitter=sum/ticks.size();
+}
+
+bool ClockSync::isValid() {
+    boost::mutex::scoped_lock lock(mutex);
+    return state.valid;
+}
+
+double ClockSync::toControllerTime(double hostTime) {
+    boost::mutex::scoped_lock lock(mutex);
+    return baseSeconds+(hostTime-baseHost-intercept)/slope;
+}
+
+double ClockSync::toHostTime(double controllerTime) {
+    boost::mutex::scoped_lock lock(mutex);
+    return baseHost+intercept+slope*(controllerTime-baseSeconds);
+}
+
+ClockSyncState ClockSync::getState() {
+    boost::mutex::scoped_lock lock(mutex);
+    return state;
+}
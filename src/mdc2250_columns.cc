@@ -0,0 +1,402 @@
+#include "mdc2250/mdc2250_columns.h"
+#include <algorithm>
+#include <cstring>
+using namespace mdc2250;
+
+/***** File Layout *****/
+
+namespace {
+
+//! Start of a column file
+struct FileHeader {
+    boost::uint32_t magic; //!< COLUMN_MAGIC
+    boost::uint32_t version; //!< COLUMN_VERSION
+    boost::uint32_t columns; //!< column::COUNT
+    boost::uint32_t reserved;
+};
+
+//! End of a column file
+struct FileTrailer {
+    boost::uint64_t indexOffset; //!< file offset of the index
+    boost::uint32_t blocks; //!< number of index entries
+    boost::uint32_t magic; //!< COLUMN_MAGIC
+};
+
+const char *COLUMN_NAMES[column::COUNT] = {
+    "time_us", "query", "E1_count", "E2_count", "E1_rel_count", "E2_rel_count",
+    "E1_rpm", "E2_rpm", "M1_cmd", "M2_cmd", "M1_deciamps", "M2_deciamps",
+    "B1_deciamps", "B2_deciamps", "driverDecivolts", "batDecivolts",
+    "fiveVMillivolts", "faults"
+};
+
+}
+
+/***** Inline Functions *****/
+
+inline void putVarint(std::string &out, boost::uint64_t value) {
+    while (value>=0x80) {
+        out+=(char)((value&0x7f)|0x80);
+        value>>=7;
+    }
+    out+=(char)value;
+}
+
+inline bool getVarint(const unsigned char *&p, const unsigned char *end, boost::uint64_t &value) {
+    value=0;
+    for (int shift=0; (p<end)&&(shift<64); shift+=7) {
+        unsigned char c=*p++;
+        value|=((boost::uint64_t)(c&0x7f))<<shift;
+        if ((c&0x80)==0)
+            return true;
+    }
+    return false;
+}
+
+// Maps small negative and positive deltas to small unsigned values
+inline boost::uint64_t zigzag(boost::int64_t value) {
+    return (((boost::uint64_t)value)<<1)^(boost::uint64_t)(value>>63);
+}
+
+inline boost::int64_t unzigzag(boost::uint64_t value) {
+    return (boost::int64_t)(value>>1)^-(boost::int64_t)(value&1);
+}
+
+// Tokens are a delta (zigzag<<1) or a run of unchanged values ((count<<1)|1)
+inline void encodeColumn(const std::vector<boost::int64_t> &values, size_t begin, size_t end,
+                         std::string &out) {
+    boost::int64_t previous=0;
+    boost::uint64_t run=0;
+    for (size_t i=begin; i<end; i++) {
+        boost::int64_t delta=values[i]-previous;
+        previous=values[i];
+        if ((delta==0)&&(i>begin)) {
+            run++;
+            continue;
+        }
+        if (run>0) {
+            putVarint(out,(run<<1)|1);
+            run=0;
+        }
+        putVarint(out,zigzag(delta)<<1);
+    }
+    if (run>0)
+        putVarint(out,(run<<1)|1);
+}
+
+inline bool decodeColumn(const unsigned char *p, const unsigned char *end, size_t rows,
+                         std::vector<boost::int64_t> &values) {
+    boost::int64_t previous=0;
+    size_t decoded=0;
+    while ((p<end)&&(decoded<rows)) {
+        boost::uint64_t token;
+        if (!getVarint(p,end,token))
+            return false;
+        if (token&1) {
+            boost::uint64_t run=token>>1;
+            if ((decoded==0)||(run>rows-decoded))
+                return false;
+            values.insert(values.end(),(size_t)run,previous);
+            decoded+=run;
+        } else {
+            previous+=unzigzag(token>>1);
+            values.push_back(previous);
+            decoded++;
+        }
+    }
+    return (p==end)&&(decoded==rows);
+}
+
+/***** ColumnSet Functions *****/
+
+const char* mdc2250::columnName(int column) {
+    if ((column<0)||(column>=column::COUNT))
+        return "";
+    return COLUMN_NAMES[column];
+}
+
+void ColumnSet::clear() {
+    for (int c=0; c<column::COUNT; c++)
+        values[c].clear();
+}
+
+void ColumnSet::reserve(size_t rows) {
+    for (int c=0; c<column::COUNT; c++)
+        values[c].reserve(rows);
+}
+
+void ColumnSet::append(boost::int64_t time, int query, const mdc2250_raw_status &status) {
+    using namespace column;
+    values[_TIME].push_back(time);
+    values[_QUERY].push_back(query);
+    values[_E1_COUNT].push_back(status.E1_count);
+    values[_E2_COUNT].push_back(status.E2_count);
+    values[_E1_REL_COUNT].push_back(status.E1_rel_count);
+    values[_E2_REL_COUNT].push_back(status.E2_rel_count);
+    values[_E1_RPM].push_back(status.E1_rpm);
+    values[_E2_RPM].push_back(status.E2_rpm);
+    values[_M1_CMD].push_back(status.M1_cmd);
+    values[_M2_CMD].push_back(status.M2_cmd);
+    values[_M1_DECIAMPS].push_back(status.M1_deciamps);
+    values[_M2_DECIAMPS].push_back(status.M2_deciamps);
+    values[_B1_DECIAMPS].push_back(status.B1_deciamps);
+    values[_B2_DECIAMPS].push_back(status.B2_deciamps);
+    values[_DRIVER_DECIVOLTS].push_back(status.driverDecivolts);
+    values[_BAT_DECIVOLTS].push_back(status.batDecivolts);
+    values[_FIVEV_MILLIVOLTS].push_back(status.fiveVMillivolts);
+    values[_FAULTS].push_back(status.faults);
+}
+
+void ColumnSet::append(const ColumnSet &other, size_t begin, size_t end) {
+    for (int c=0; c<column::COUNT; c++)
+        values[c].insert(values[c].end(),other.values[c].begin()+begin,other.values[c].begin()+end);
+}
+
+void ColumnSet::getStatus(size_t row, mdc2250_raw_status &status) const {
+    using namespace column;
+    std::memset(&status,0,sizeof(status));
+    status.time=values[_TIME][row]/1.0e6;
+    status.E1_count=(boost::int32_t)values[_E1_COUNT][row];
+    status.E2_count=(boost::int32_t)values[_E2_COUNT][row];
+    status.E1_rel_count=(boost::int32_t)values[_E1_REL_COUNT][row];
+    status.E2_rel_count=(boost::int32_t)values[_E2_REL_COUNT][row];
+    status.E1_rpm=(boost::int32_t)values[_E1_RPM][row];
+    status.E2_rpm=(boost::int32_t)values[_E2_RPM][row];
+    status.M1_cmd=(boost::int16_t)values[_M1_CMD][row];
+    status.M2_cmd=(boost::int16_t)values[_M2_CMD][row];
+    status.M1_deciamps=(boost::int16_t)values[_M1_DECIAMPS][row];
+    status.M2_deciamps=(boost::int16_t)values[_M2_DECIAMPS][row];
+    status.B1_deciamps=(boost::int16_t)values[_B1_DECIAMPS][row];
+    status.B2_deciamps=(boost::int16_t)values[_B2_DECIAMPS][row];
+    status.driverDecivolts=(boost::uint16_t)values[_DRIVER_DECIVOLTS][row];
+    status.batDecivolts=(boost::uint16_t)values[_BAT_DECIVOLTS][row];
+    status.fiveVMillivolts=(boost::uint16_t)values[_FIVEV_MILLIVOLTS][row];
+    status.faults=(boost::uint8_t)values[_FAULTS][row];
+}
+
+/***** Block Encoding *****/
+
+void mdc2250::encodeBlock(const ColumnSet &set, size_t begin, size_t end, ColumnBlock &block) {
+    block.data.clear();
+    block.rows=(boost::uint32_t)(end-begin);
+    block.minTime=block.maxTime=0;
+    if (end>begin) {
+        const std::vector<boost::int64_t> &time=set.values[column::_TIME];
+        block.minTime=*std::min_element(time.begin()+begin,time.begin()+end);
+        block.maxTime=*std::max_element(time.begin()+begin,time.begin()+end);
+    }
+    // each column is preceded by its encoded length
+    std::string encoded;
+    for (int c=0; c<column::COUNT; c++) {
+        encoded.clear();
+        encodeColumn(set.values[c],begin,end,encoded);
+        putVarint(block.data,encoded.length());
+        block.data+=encoded;
+    }
+}
+
+bool mdc2250::decodeBlock(const char *data, size_t length, size_t rows, ColumnSet &set) {
+    const unsigned char *p=(const unsigned char*)data;
+    const unsigned char *end=p+length;
+    if (rows>COLUMN_MAX_BLOCK_ROWS)
+        return false;
+    ColumnSet decoded;
+    for (int c=0; c<column::COUNT; c++) {
+        boost::uint64_t size;
+        if (!getVarint(p,end,size)||(size>(boost::uint64_t)(end-p)))
+            return false;
+        // a delta takes at least a byte, longer columns grow from runs
+        decoded.values[c].reserve(std::min(rows,(size_t)size));
+        if (!decodeColumn(p,p+size,rows,decoded.values[c]))
+            return false;
+        p+=size;
+    }
+    if (p!=end)
+        return false;
+    set.append(decoded,0,rows);
+    return true;
+}
+
+/***** ColumnWriter Class Functions *****/
+
+ColumnWriter::ColumnWriter() : offset(0), rowCount(0) {
+}
+
+ColumnWriter::~ColumnWriter() {
+    close();
+}
+
+bool ColumnWriter::open(const std::string &path) {
+    if (file.is_open())
+        close();
+    index.clear();
+    rowCount=0;
+    file.clear();
+    file.open(path.c_str(),std::ios::out|std::ios::binary|std::ios::trunc);
+    if (!file)
+        return false;
+    FileHeader header;
+    header.magic=COLUMN_MAGIC;
+    header.version=COLUMN_VERSION;
+    header.columns=column::COUNT;
+    header.reserved=0;
+    file.write((const char*)&header,sizeof(header));
+    offset=sizeof(header);
+    return file.good();
+}
+
+bool ColumnWriter::write(const ColumnBlock &block) {
+    if (!file.is_open())
+        return false;
+    if (block.rows==0)
+        return true;
+    if (block.rows>COLUMN_MAX_BLOCK_ROWS)
+        return false;
+    ColumnIndexEntry entry;
+    entry.offset=offset;
+    entry.rows=block.rows;
+    entry.length=(boost::uint32_t)block.data.length();
+    entry.minTime=block.minTime;
+    entry.maxTime=block.maxTime;
+    file.write(block.data.data(),block.data.length());
+    index.push_back(entry);
+    offset+=block.data.length();
+    rowCount+=block.rows;
+    return file.good();
+}
+
+bool ColumnWriter::write(const ColumnSet &set, size_t blockRows) {
+    blockRows=std::min(std::max(blockRows,(size_t)1),COLUMN_MAX_BLOCK_ROWS);
+    ColumnBlock block;
+    for (size_t begin=0; begin<set.rows(); begin+=blockRows) {
+        encodeBlock(set,begin,std::min(begin+blockRows,set.rows()),block);
+        if (!write(block))
+            return false;
+    }
+    return true;
+}
+
+bool ColumnWriter::close() {
+    if (!file.is_open())
+        return false;
+    FileTrailer trailer;
+    trailer.indexOffset=offset;
+    trailer.blocks=(boost::uint32_t)index.size();
+    trailer.magic=COLUMN_MAGIC;
+    if (!index.empty())
+        file.write((const char*)&index[0],index.size()*sizeof(ColumnIndexEntry));
+    file.write((const char*)&trailer,sizeof(trailer));
+    bool result=file.good();
+    file.close();
+    index.clear();
+    return result;
+}
+
+/***** ColumnReader Class Functions *****/
+
+ColumnReader::ColumnReader() : corrupt(false) {
+}
+
+ColumnReader::~ColumnReader() {
+    close();
+}
+
+bool ColumnReader::open(const std::string &path) {
+    close();
+    corrupt=false;
+    file.clear();
+    file.open(path.c_str(),std::ios::in|std::ios::binary);
+    if (!file)
+        return false;
+
+    FileHeader header;
+    FileTrailer trailer;
+    if (!file.read((char*)&header,sizeof(header))||(header.magic!=COLUMN_MAGIC)
+        ||(header.version!=COLUMN_VERSION)||(header.columns!=column::COUNT)
+        ||!file.seekg(-(std::streamoff)sizeof(trailer),std::ios::end)
+        ||!file.read((char*)&trailer,sizeof(trailer))||(trailer.magic!=COLUMN_MAGIC)) {
+        close();
+        return false;
+    }
+    // the index sits between the last block and the trailer
+    boost::uint64_t size=(boost::uint64_t)file.tellg();
+    boost::uint64_t indexEnd=size-sizeof(trailer);
+    if ((trailer.indexOffset<sizeof(header))||(trailer.indexOffset>indexEnd)
+        ||((boost::uint64_t)trailer.blocks*sizeof(ColumnIndexEntry)!=indexEnd-trailer.indexOffset)) {
+        close();
+        corrupt=true;
+        return false;
+    }
+    index.resize(trailer.blocks);
+    if (!file.seekg(trailer.indexOffset)
+        ||(!index.empty()&&!file.read((char*)&index[0],index.size()*sizeof(ColumnIndexEntry)))) {
+        close();
+        corrupt=true;
+        return false;
+    }
+    // every block must lie between the header and the index
+    for (size_t i=0; i<index.size(); i++) {
+        const ColumnIndexEntry &entry=index[i];
+        if ((entry.offset<sizeof(header))||(entry.offset>trailer.indexOffset)
+            ||(entry.length>trailer.indexOffset-entry.offset)||(entry.rows>COLUMN_MAX_BLOCK_ROWS)) {
+            close();
+            corrupt=true;
+            return false;
+        }
+    }
+    return true;
+}
+
+void ColumnReader::close() {
+    if (file.is_open())
+        file.close();
+    index.clear();
+}
+
+boost::uint64_t ColumnReader::rows() const {
+    boost::uint64_t result=0;
+    for (size_t i=0; i<index.size(); i++)
+        result+=index[i].rows;
+    return result;
+}
+
+void ColumnReader::getTimeRange(boost::int64_t &minTime, boost::int64_t &maxTime) const {
+    minTime=maxTime=0;
+    for (size_t i=0; i<index.size(); i++) {
+        if ((i==0)||(index[i].minTime<minTime))
+            minTime=index[i].minTime;
+        if ((i==0)||(index[i].maxTime>maxTime))
+            maxTime=index[i].maxTime;
+    }
+}
+
+bool ColumnReader::readRange(boost::int64_t from, boost::int64_t to, ColumnSet &set) {
+    if (!file.is_open())
+        return false;
+    std::string data;
+    ColumnSet block;
+    for (size_t i=0; i<index.size(); i++) {
+        const ColumnIndexEntry &entry=index[i];
+        if ((entry.maxTime<from)||(entry.minTime>to))
+            continue;
+        data.resize(entry.length);
+        file.clear();
+        if (!file.seekg(entry.offset)||(entry.length&&!file.read(&data[0],entry.length)))
+            return false;
+        block.clear();
+        if (!decodeBlock(data.data(),data.length(),entry.rows,block))
+            return false;
+
+        // keep only the rows in range
+        const std::vector<boost::int64_t> &time=block.values[column::_TIME];
+        for (size_t row=0; row<block.rows(); row++) {
+            if ((time[row]<from)||(time[row]>to))
+                continue;
+            size_t end=row+1;
+            while ((end<block.rows())&&(time[end]>=from)&&(time[end]<=to))
+                end++;
+            set.append(block,row,end);
+            row=end-1;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,194 @@
+#include "mdc2250/mdc2250_commands.h"
+#include <algorithm>
+#include <sstream>
+#include <vector>
+using namespace mdc2250;
+using namespace commanditem;
+
+/***** Command Formatting *****/
+
+// Returns the command word of an item, NULL if unknown
+inline const char* commandName(CommandItem item) {
+    switch (item) {
+        case _GO: return "!G";
+        case _MOTCMD: return "!M";
+        case _MOTPOS: return "!P";
+        case _MOTVEL: return "!S";
+        case _SENCNTR: return "!C";
+        case _SBLCNTR: return "!CB";
+        case _VAR: return "!VAR";
+        case _ACCEL: return "!AC";
+        case _DECEL: return "!DC";
+        case _DOUT: return "!DS";
+        case _DSET: return "!D1";
+        case _DRES: return "!D0";
+        case _HOME: return "!H";
+        case _ESTOP: return "!EX";
+        case _MGO: return "!MG";
+        default: return NULL;
+    }
+}
+
+int mdc2250::commandArguments(CommandItem item) {
+    switch (item) {
+        case _ESTOP:
+        case _MGO:
+            return 0;
+        case _DOUT:
+        case _DSET:
+        case _DRES:
+        case _HOME:
+            return 1;
+        default:
+            return commandName(item) ? 2 : -1;
+    }
+}
+
+std::string mdc2250::formatCommand(CommandItem item, long arg1, long arg2) {
+    const char *name=commandName(item);
+    if (!name)
+        return "";
+    std::stringstream cmd;
+    cmd << name;
+    int count=commandArguments(item);
+    if (count>0)
+        cmd << " " << arg1;
+    if (count>1)
+        cmd << " " << arg2;
+    return cmd.str();
+}
+
+/***** CommandBatcher Class Functions *****/
+
+CommandBatcher::CommandBatcher(size_t maxFrame)
+    : maxFrame(maxFrame), outputs(0), changed(0), known(false),
+      writeAll(false) {
+}
+
+bool CommandBatcher::setOutput(int output, bool state) {
+    if ((output<1)||(output>DIGITAL_OUTPUTS))
+        return false;
+    int bit=1<<(output-1);
+    boost::mutex::scoped_lock lock(mutex);
+    if (state)
+        outputs|=bit;
+    else
+        outputs&=~bit;
+    changed|=bit;
+    return true;
+}
+
+void CommandBatcher::setOutputs(int mask) {
+    boost::mutex::scoped_lock lock(mutex);
+    outputs=mask&((1<<DIGITAL_OUTPUTS)-1);
+    changed=0;
+    known=true;
+    writeAll=true;
+}
+
+void CommandBatcher::outputsRead(int mask) {
+    boost::mutex::scoped_lock lock(mutex);
+    // a pending or unconfirmed write is newer than anything read back
+    if (writeAll||!unechoed.empty())
+        return;
+    outputs=(mask&~changed&((1<<DIGITAL_OUTPUTS)-1))|(outputs&changed);
+    known=true;
+}
+
+void CommandBatcher::outputsEchoed(const char *begin, const char *end) {
+    boost::mutex::scoped_lock lock(mutex);
+    std::deque<std::string>::iterator it=unechoed.begin();
+    for (; it!=unechoed.end(); ++it) {
+        if ((it->length()==(size_t)(end-begin))&&std::equal(begin,end,it->begin())) {
+            unechoed.erase(it);
+            return;
+        }
+    }
+}
+
+int CommandBatcher::getOutputs() {
+    boost::mutex::scoped_lock lock(mutex);
+    return outputs;
+}
+
+void CommandBatcher::setVariable(int index, long value) {
+    boost::mutex::scoped_lock lock(mutex);
+    variables[index]=value;
+}
+
+bool CommandBatcher::pending() {
+    boost::mutex::scoped_lock lock(mutex);
+    return writeAll||(changed!=0)||!variables.empty();
+}
+
+std::string CommandBatcher::take(Taken &taken) {
+    // one lock throughout, so no read back slips in before unechoed counts the write
+    boost::mutex::scoped_lock lock(mutex);
+    std::vector<std::string> commands;
+    if (writeAll||(known&&changed)) {
+        commands.push_back(formatCommand(_DOUT,outputs));
+    } else {
+        for (int output=1; output<=DIGITAL_OUTPUTS; output++)
+            if (changed&(1<<(output-1)))
+                commands.push_back(formatCommand((outputs&(1<<(output-1))) ? _DSET : _DRES,output));
+    }
+    size_t outputCommands=commands.size();
+    taken.changed=changed;
+    taken.writeAll=writeAll;
+    taken.frames.clear();
+    changed=0;
+    writeAll=false;
+    for (std::map<int,long>::const_iterator it=variables.begin(); it!=variables.end(); ++it)
+        commands.push_back(formatCommand(_VAR,it->first,it->second));
+    taken.variables.swap(variables);
+    variables.clear();
+
+    // join with '_' and start a new frame when the next would not fit
+    std::string result, frame;
+    bool outputFrame=false;
+    for (size_t i=0; i<commands.size(); i++) {
+        if (!frame.empty()&&(frame.length()+commands[i].length()+2>maxFrame)) {
+            if (outputFrame)
+                taken.frames.push_back(frame);
+            result+=frame+"\r";
+            frame.clear();
+        }
+        if (!frame.empty())
+            frame+="_";
+        else
+            outputFrame=(i<outputCommands);
+        frame+=commands[i];
+    }
+    if (!frame.empty()) {
+        if (outputFrame)
+            taken.frames.push_back(frame);
+        result+=frame+"\r";
+    }
+    // each frame with output commands is echoed once
+    unechoed.insert(unechoed.end(),taken.frames.begin(),taken.frames.end());
+    return result;
+}
+
+void CommandBatcher::restore(const Taken &taken) {
+    boost::mutex::scoped_lock lock(mutex);
+    // outputs still holds the taken values unless they were changed since
+    changed|=taken.changed;
+    writeAll=writeAll||taken.writeAll;
+    for (std::map<int,long>::const_iterator it=taken.variables.begin(); it!=taken.variables.end(); ++it)
+        variables.insert(*it);
+    for (size_t i=0; i<taken.frames.size(); i++) {
+        std::deque<std::string>::iterator it=std::find(unechoed.begin(),unechoed.end(),taken.frames[i]);
+        if (it!=unechoed.end())
+            unechoed.erase(it);
+    }
+}
+
+void CommandBatcher::reset() {
+    boost::mutex::scoped_lock lock(mutex);
+    outputs=0;
+    changed=0;
+    known=false;
+    writeAll=false;
+    unechoed.clear();
+    variables.clear();
+}
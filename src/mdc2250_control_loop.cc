@@ -0,0 +1,140 @@
+#include "mdc2250/mdc2250_control_loop.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <cstring>
+#include <sstream>
+#include <boost/bind.hpp>
+using namespace mdc2250;
+
+/***** Setpoint Packing *****/
+
+// The setpoint slot holds both commands as 16 bit values, the publish time
+// as 30 bits of microseconds (wraps after ~17 minutes, ages are computed
+// modulo that) and two flags.
+static const boost::uint64_t TIME_MASK = (1ULL<<30)-1;
+static const boost::uint64_t VALID_BIT = 1ULL<<62;
+static const boost::uint64_t FRESH_BIT = 1ULL<<63;
+
+inline boost::uint64_t packSetpoint(int cmd1, int cmd2, boost::uint64_t micros) {
+    return (boost::uint64_t)(boost::uint16_t)(boost::int16_t)cmd1
+        | ((boost::uint64_t)(boost::uint16_t)(boost::int16_t)cmd2<<16)
+        | ((micros&TIME_MASK)<<32) | VALID_BIT | FRESH_BIT;
+}
+
+inline int unpackCommand(boost::uint64_t packed, int index) {
+    return (boost::int16_t)(boost::uint16_t)(packed>>(16*index));
+}
+
+inline boost::uint64_t unpackTime(boost::uint64_t packed) {
+    return (packed>>32)&TIME_MASK;
+}
+
+inline int clampCommand(int cmd) {
+    if (cmd>1000)
+        return 1000;
+    if (cmd<-1000)
+        return -1000;
+    return cmd;
+}
+
+/***** ControlLoop Class Functions *****/
+
+ControlLoop::ControlLoop(SendFunction sendFunction, TickFunction tickFunction)
+    : send(sendFunction), tick(tickFunction), running(false),
+      epoch(monotonicTime()), setpoint(0), published(0), ageSum(0) {
+    std::memset(&stats,0,sizeof(stats));
+}
+
+ControlLoop::~ControlLoop() {
+    stop();
+}
+
+void ControlLoop::start(const ControlLoopOptions &newOptions) {
+    stop();
+    options=newOptions;
+    if (options.periodUs<=0)
+        options.periodUs=10000;
+    {
+        boost::mutex::scoped_lock lock(statsMutex);
+        std::memset(&stats,0,sizeof(stats));
+        ageSum=0;
+    }
+    published=0;
+    // a setpoint from before the last stop must never be resent
+    setpoint.store(0);
+    timer.reset();
+    running=true;
+    thread.reset(new boost::thread(boost::bind(&ControlLoop::run,this)));
+}
+
+void ControlLoop::stop() {
+    if (!thread)
+        return;
+    // route new commands around the loop before it winds down
+    running=false;
+    timer.cancel();
+    thread->join();
+    thread.reset();
+}
+
+void ControlLoop::publish(int cmd1, int cmd2) {
+    setpoint.store(packSetpoint(clampCommand(cmd1),clampCommand(cmd2),elapsedMicros()),
+                   boost::memory_order_release);
+    published.fetch_add(1,boost::memory_order_relaxed);
+}
+
+ControlLoopStats ControlLoop::getStats() {
+    boost::mutex::scoped_lock lock(statsMutex);
+    ControlLoopStats result=stats;
+    result.published=published.load(boost::memory_order_relaxed);
+    result.dropped=(result.published>result.sent) ? result.published-result.sent : 0;
+    result.meanSetpointAge=(stats.sent>0) ? ageSum/stats.sent : 0.0;
+    return result;
+}
+
+boost::uint64_t ControlLoop::elapsedMicros() const {
+    return (boost::uint64_t)((monotonicTime()-epoch)*1.0e6);
+}
+
+void ControlLoop::run() {
+    applyRealtimeOptions(options.realtime);
+
+    double period=options.periodUs/1.0e6;
+    double deadline=monotonicTime()+period;
+    while (timer.waitUntil(deadline)) {
+        double jitter=monotonicTime()-deadline;
+
+        // take the latest setpoint and mark it as consumed
+        boost::uint64_t current=setpoint.fetch_and(~FRESH_BIT,boost::memory_order_acquire);
+        double age=0;
+        if (current&VALID_BIT) {
+            std::stringstream cmd;
+            cmd << "!M " << unpackCommand(current,0) << " " << unpackCommand(current,1) << "\r";
+            send(cmd.str());
+            age=((elapsedMicros()-unpackTime(current))&TIME_MASK)/1.0e6;
+        }
+        if (tick)
+            tick();
+
+        // schedule the next tick, skipping any that were already missed
+        double now=monotonicTime();
+        unsigned long missed=0;
+        deadline+=period;
+        while (deadline<=now) {
+            deadline+=period;
+            missed++;
+        }
+
+        boost::mutex::scoped_lock lock(statsMutex);
+        stats.ticks++;
+        stats.overruns+=missed;
+        if (jitter>stats.maxJitter)
+            stats.maxJitter=jitter;
+        if (current&FRESH_BIT) {
+            stats.sent++;
+            stats.lastSetpointAge=age;
+            ageSum+=age;
+            if (age>stats.maxSetpointAge)
+                stats.maxSetpointAge=age;
+        }
+    }
+}
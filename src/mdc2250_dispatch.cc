@@ -0,0 +1,174 @@
+#include "mdc2250/mdc2250_dispatch.h"
+#include "mdc2250/mdc2250_trace.h"
+#include <iostream>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+using namespace mdc2250;
+
+/***** Subscriber Class *****/
+
+//! Ring, worker thread and counters of one subscriber
+class QueryDispatcher::Subscriber {
+public:
+    Subscriber(int id, Callback callback, const SubscriberOptions &options)
+        : id(id), callback(callback), options(options), ring(options.capacity),
+          running(true), waiting(false), delivered(0), dropped(0),
+          coalesced(0) {
+        thread.reset(new boost::thread(boost::bind(&Subscriber::run,this)));
+    }
+
+    ~Subscriber() {
+        stop();
+    }
+
+    // Called by the read thread
+    void push(const QueryEvent &event) {
+        if (!ring.push(event))
+            dropped++;
+        // the ring's release store may otherwise pass the load of waiting,
+        // pairs with the fence in run()
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        if (waiting.load()) {
+            boost::mutex::scoped_lock lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    void stop() {
+        if (!thread)
+            return;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            running=false;
+            wake.notify_one();
+        }
+        thread->join();
+        thread.reset();
+    }
+
+    SubscriberStats getStats() {
+        SubscriberStats stats;
+        stats.delivered=delivered.load();
+        stats.dropped=dropped.load();
+        stats.coalesced=coalesced.load();
+        stats.queued=ring.size();
+        return stats;
+    }
+
+    const int id;
+
+private:
+    void run() {
+        trace::setThreadName("subscriber");
+        QueryEvent event;
+        while (running.load()) {
+            bool received;
+            if (options.policy==overflowpolicy::_COALESCE_LATEST) {
+                boost::uint64_t skipped=0;
+                received=ring.popLatest(event,skipped);
+                coalesced+=(unsigned long)skipped;
+            } else {
+                received=ring.pop(event);
+            }
+            if (received) {
+                trace::Span span("subscriber",event.query);
+                try {
+                    callback(event.status,event.query);
+                } catch (std::exception &e) {
+                    std::cout << "Error in query subscriber: " << e.what() << std::endl;
+                }
+                delivered++;
+                continue;
+            }
+
+            // announce the wait before checking the ring again, so a push
+            // in between either is seen here or sees waiting and notifies
+            boost::mutex::scoped_lock lock(mutex);
+            waiting=true;
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            if (ring.empty()&&running.load())
+                wake.wait(lock);
+            waiting=false;
+        }
+    }
+
+    Callback callback;
+    SubscriberOptions options;
+    SpscRing<QueryEvent> ring;
+    boost::scoped_ptr<boost::thread> thread;
+    boost::mutex mutex; //!< pairs with wake
+    boost::condition_variable wake;
+    boost::atomic<bool> running;
+    boost::atomic<bool> waiting; //!< the worker is about to sleep or asleep
+    boost::atomic<unsigned long> delivered;
+    boost::atomic<unsigned long> dropped;
+    boost::atomic<unsigned long> coalesced;
+};
+
+/***** QueryDispatcher Class Functions *****/
+
+QueryDispatcher::QueryDispatcher() : subscribers(new SubscriberList()), nextId(1) {
+}
+
+QueryDispatcher::~QueryDispatcher() {
+    clear();
+}
+
+int QueryDispatcher::add(Callback callback, const SubscriberOptions &options) {
+    boost::mutex::scoped_lock lock(mutex);
+    boost::shared_ptr<SubscriberList> list(new SubscriberList(*subscribers));
+    int id=nextId++;
+    list->push_back(boost::make_shared<Subscriber>(id,callback,options));
+    boost::atomic_store(&subscribers,boost::shared_ptr<const SubscriberList>(list));
+    return id;
+}
+
+void QueryDispatcher::remove(int id) {
+    boost::shared_ptr<Subscriber> removed;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        boost::shared_ptr<SubscriberList> list(new SubscriberList());
+        for (size_t i=0; i<subscribers->size(); i++) {
+            if ((*subscribers)[i]->id==id)
+                removed=(*subscribers)[i];
+            else
+                list->push_back((*subscribers)[i]);
+        }
+        boost::atomic_store(&subscribers,boost::shared_ptr<const SubscriberList>(list));
+    }
+    // the read thread may still hold the old list, stop the worker now and
+    // let the last reference free the ring
+    if (removed)
+        removed->stop();
+}
+
+void QueryDispatcher::clear() {
+    boost::shared_ptr<const SubscriberList> old;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        old=subscribers;
+        boost::atomic_store(&subscribers,boost::shared_ptr<const SubscriberList>(new SubscriberList()));
+    }
+    for (size_t i=0; i<old->size(); i++)
+        (*old)[i]->stop();
+}
+
+SubscriberStats QueryDispatcher::getStats(int id) {
+    boost::shared_ptr<const SubscriberList> list=boost::atomic_load(&subscribers);
+    for (size_t i=0; i<list->size(); i++)
+        if ((*list)[i]->id==id)
+            return (*list)[i]->getStats();
+    return SubscriberStats();
+}
+
+void QueryDispatcher::publish(const mdc2250_raw_status &status, RuntimeQuery::runtimeQuery query) {
+    boost::shared_ptr<const SubscriberList> list=boost::atomic_load(&subscribers);
+    if (list->empty())
+        return;
+    QueryEvent event;
+    event.status=status;
+    event.query=query;
+    for (size_t i=0; i<list->size(); i++)
+        (*list)[i]->push(event);
+}
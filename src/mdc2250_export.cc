@@ -0,0 +1,400 @@
+/*
+ * mdc2250_export - converts recorded controller output into a column file
+ * and reads time ranges back out of one.
+ *
+ * Usage: mdc2250_export [-j threads] [-c chunk MB] [-m memory MB] <input> <output.mdct>
+ *        mdc2250_export -r <from s> <to s> <input.mdct>
+ *
+ * The input is either a capture written by MDC2250::enableCapture or a raw
+ * dump of the serial port.  Capture rows are stamped with the wall clock
+ * time each read arrived; raw dumps carry no arrival times, so rows are
+ * stamped with the controller time of the last ?TM response and "?TM"
+ * should be part of the telemetry string of such recordings.
+ *
+ * The input is cut into chunks at frame boundaries.  A wave of chunks,
+ * one per thread, is decoded in parallel with the library's decoder, the
+ * status carried across chunk boundaries is filled in, the rows are
+ * encoded in parallel and the blocks are appended in order.  The decoded
+ * rows of a wave are the bulk of the memory used, up to 144 bytes for a
+ * 3 byte frame, so chunks are cut small enough, and fewer threads used if
+ * needed, that a wave of the worst case input stays within -m (256 MB by
+ * default).  A chunk's rows are freed as soon as they are encoded.
+ *
+ * The range mode prints the rows between two times as CSV, decoding only
+ * the blocks that overlap the range.
+ */
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "mdc2250/mdc2250_capture.h"
+#include "mdc2250/mdc2250_columns.h"
+#include "mdc2250/mdc2250_decoder.h"
+using namespace mdc2250;
+using namespace RuntimeQuery;
+
+static const size_t ROW_BYTES = column::COUNT*sizeof(boost::int64_t); //!< decoded size of a row
+static const size_t MIN_ROW_FRAME = 3; //!< shortest frame decoded into a row, e.g. "A=\r"
+static const size_t MIN_CHUNK_SIZE = 64*1024; //!< smallest chunk cut to fit the memory bound
+
+/***** Chunks *****/
+
+//! Bytes of a read, with the time they arrived
+struct Piece {
+    size_t end; //!< offset in Chunk::data one past the last byte
+    boost::int64_t time; //!< wall clock arrival time [us], -1 for raw dumps
+};
+
+//! A run of whole frames, decoded independently of the other chunks
+struct Chunk {
+    std::string data;
+    std::vector<Piece> pieces;
+    ColumnSet rows;
+    size_t firstSeen[column::COUNT]; //!< first row holding a decoded value of each column
+    std::vector<ColumnBlock> blocks;
+};
+
+//! Reads the input and cuts it into chunks ending with a '\r'
+class ChunkReader {
+public:
+    ChunkReader(std::istream &input, size_t chunkSize)
+        : input(input), chunkSize(chunkSize), capture(false), corrupt(false), offset(0), end(0) {}
+
+    //! Reads the capture header, if the input has one
+    void detect() {
+        capture=readCaptureHeader(input,header);
+        if (!capture) {
+            input.clear();
+            input.seekg(0);
+        } else {
+            // monotonic record times are mapped to the wall clock
+            offset=header.wallStart-header.monotonicStart;
+            std::streampos start=input.tellg();
+            input.seekg(0,std::ios::end);
+            end=(boost::uint64_t)input.tellg();
+            input.seekg(start);
+        }
+    }
+
+    bool isCapture() const { return capture; }
+    //! Returns true if a capture record runs past the end of the input
+    bool isCorrupt() const { return corrupt; }
+
+    //! Fills the next chunk, false at the end of the input
+    bool next(Chunk &chunk) {
+        chunk.data=carry;
+        chunk.pieces.clear();
+        if (!carry.empty()) {
+            Piece piece;
+            piece.end=carry.length();
+            piece.time=carryTime;
+            chunk.pieces.push_back(piece);
+        }
+        carry.clear();
+
+        size_t carried=chunk.data.length();
+        if (capture)
+            readRecords(chunk);
+        else
+            readRaw(chunk);
+        // a frame left without its '\r' at the end of the input is dropped
+        if (chunk.data.length()==carried) {
+            chunk.data.clear();
+            chunk.pieces.clear();
+            return false;
+        }
+
+        // a frame cut at the end of the chunk goes to the next one
+        size_t last=chunk.data.rfind('\r');
+        size_t cut=(last==std::string::npos) ? 0 : last+1;
+        if (cut<chunk.data.length()) {
+            carry.assign(chunk.data,cut,std::string::npos);
+            carryTime=chunk.pieces.back().time;
+            chunk.data.erase(cut);
+            size_t keep=0;
+            while ((keep<chunk.pieces.size())&&(chunk.pieces[keep].end<cut))
+                keep++;
+            if (keep<chunk.pieces.size()) {
+                chunk.pieces[keep].end=cut;
+                chunk.pieces.resize(keep+1);
+            }
+            // no frame is this long, the input is not controller output
+            if (carry.length()>chunkSize)
+                carry.clear();
+        }
+        return true;
+    }
+
+private:
+    void readRaw(Chunk &chunk) {
+        size_t start=chunk.data.length();
+        chunk.data.resize(start+chunkSize);
+        input.read(&chunk.data[start],chunkSize);
+        chunk.data.resize(start+(size_t)input.gcount());
+        Piece piece;
+        piece.end=chunk.data.length();
+        piece.time=-1;
+        if (chunk.pieces.empty()||(piece.end>chunk.pieces.back().end))
+            chunk.pieces.push_back(piece);
+    }
+
+    void readRecords(Chunk &chunk) {
+        CaptureRecord record;
+        while ((chunk.data.length()<chunkSize)&&input.read((char*)&record,sizeof(record))) {
+            // check the length before allocating, a damaged one may be huge
+            if (record.length>end-(boost::uint64_t)input.tellg()) {
+                corrupt=true;
+                input.setstate(std::ios::eofbit);
+                break;
+            }
+            size_t start=chunk.data.length();
+            chunk.data.resize(start+record.length);
+            input.read(&chunk.data[start],record.length);
+            chunk.data.resize(start+(size_t)input.gcount());
+            Piece piece;
+            piece.end=chunk.data.length();
+            piece.time=record.time+offset;
+            chunk.pieces.push_back(piece);
+        }
+    }
+
+    std::istream &input;
+    size_t chunkSize;
+    bool capture;
+    bool corrupt;
+    CaptureHeader header;
+    boost::int64_t offset; //!< wall clock minus monotonic time [us]
+    boost::uint64_t end; //!< size of the capture file [bytes]
+    std::string carry; //!< partial frame at the end of the last chunk
+    boost::int64_t carryTime;
+};
+
+/***** Decoding *****/
+
+// Returns the columns a query response stores, as a bit mask
+unsigned long queryColumns(runtimeQuery query) {
+    using namespace column;
+    switch (query) {
+        case _MOTAMPS: return (1ul<<_M1_DECIAMPS)|(1ul<<_M2_DECIAMPS);
+        case _MOTCMD: return (1ul<<_M1_CMD)|(1ul<<_M2_CMD);
+        case _ABSPEED: return (1ul<<_E1_RPM)|(1ul<<_E2_RPM);
+        case _ABCNTR: return (1ul<<_E1_COUNT)|(1ul<<_E2_COUNT);
+        case _RELCNTR: return (1ul<<_E1_REL_COUNT)|(1ul<<_E2_REL_COUNT);
+        case _BATAMPS: return (1ul<<_B1_DECIAMPS)|(1ul<<_B2_DECIAMPS);
+        case _VOLTS: return (1ul<<_DRIVER_DECIVOLTS)|(1ul<<_BAT_DECIVOLTS)|(1ul<<_FIVEV_MILLIVOLTS);
+        case _FLTFLAG: return 1ul<<_FAULTS;
+        default: return 0;
+    }
+}
+
+//! Appends a row for every query response of a chunk
+struct RowHandler : public DecoderHandler {
+    Chunk &chunk;
+    boost::int64_t time; //!< time of the rows being decoded [us]
+    unsigned long seen; //!< columns decoded so far in this chunk
+
+    RowHandler(Chunk &chunk) : chunk(chunk), time(0), seen(0) {}
+
+    void onQuery(const mdc2250_raw_status &status, runtimeQuery query,
+                 const long *values, int count) {
+        unsigned long columns=queryColumns(query);
+        if ((query==_TIME)&&(count>0)&&(chunk.pieces.empty()||(chunk.pieces[0].time<0))) {
+            time=(boost::int64_t)values[0]*1000000;
+            columns|=1ul<<column::_TIME;
+        }
+        size_t row=chunk.rows.rows();
+        for (int c=0; c<column::COUNT; c++)
+            if ((columns&~seen)&(1ul<<c))
+                chunk.firstSeen[c]=row;
+        seen|=columns;
+        chunk.rows.append(time,query,status);
+    }
+};
+
+void decodeChunk(Chunk &chunk) {
+    chunk.rows.clear();
+    for (int c=0; c<column::COUNT; c++)
+        chunk.firstSeen[c]=(size_t)-1;
+    // capture rows are stamped with the read and never need filling in
+    bool stamped=!chunk.pieces.empty()&&(chunk.pieces[0].time>=0);
+    if (stamped)
+        chunk.firstSeen[column::_TIME]=0;
+    chunk.firstSeen[column::_QUERY]=0;
+    // the most rows the chunk can hold, so the columns never grow past it
+    chunk.rows.reserve(chunk.data.length()/MIN_ROW_FRAME);
+
+    mdc2250_raw_status status;
+    std::memset(&status,0,sizeof(status));
+    RowHandler handler(chunk);
+    size_t frame=0;
+    for (size_t i=0; i<chunk.pieces.size(); i++) {
+        if (stamped)
+            handler.time=chunk.pieces[i].time;
+        frame+=decodeBuffer(chunk.data.data()+frame,chunk.pieces[i].end-frame,status,handler);
+    }
+    // the input is no longer needed once decoded
+    std::string().swap(chunk.data);
+}
+
+// Fills the columns not yet decoded at the start of a chunk from the last row before it
+void stitchChunk(Chunk &chunk, boost::int64_t *carried) {
+    size_t rows=chunk.rows.rows();
+    for (int c=0; c<column::COUNT; c++) {
+        std::vector<boost::int64_t> &values=chunk.rows.values[c];
+        size_t end=std::min(chunk.firstSeen[c],rows);
+        for (size_t row=0; row<end; row++)
+            values[row]=carried[c];
+        if (rows>0)
+            carried[c]=values[rows-1];
+    }
+}
+
+void encodeChunk(Chunk &chunk) {
+    size_t rows=chunk.rows.rows();
+    chunk.blocks.resize((rows+COLUMN_BLOCK_ROWS-1)/COLUMN_BLOCK_ROWS);
+    for (size_t i=0; i<chunk.blocks.size(); i++)
+        encodeBlock(chunk.rows,i*COLUMN_BLOCK_ROWS,std::min((i+1)*COLUMN_BLOCK_ROWS,rows),chunk.blocks[i]);
+    // the rows are no longer needed once encoded
+    for (int c=0; c<column::COUNT; c++)
+        std::vector<boost::int64_t>().swap(chunk.rows.values[c]);
+}
+
+// Runs a step on every chunk of a wave, one thread each
+void runWave(std::vector<Chunk> &wave, size_t count, void (*step)(Chunk&)) {
+    boost::thread_group threads;
+    for (size_t i=1; i<count; i++)
+        threads.create_thread(boost::bind(step,boost::ref(wave[i])));
+    step(wave[0]);
+    threads.join_all();
+}
+
+/***** Modes *****/
+
+// Converts a time in seconds to microseconds, saturating outside the int64 range
+boost::int64_t toMicroseconds(double time) {
+    if (time*1.0e6>=9.2e18)
+        return std::numeric_limits<boost::int64_t>::max();
+    if (time*1.0e6<=-9.2e18)
+        return std::numeric_limits<boost::int64_t>::min();
+    return (boost::int64_t)(time*1.0e6);
+}
+
+int convert(const std::string &inputPath, const std::string &outputPath,
+            size_t threads, size_t chunkSize, size_t memory) {
+    std::ifstream input(inputPath.c_str(),std::ios::in|std::ios::binary);
+    if (!input) {
+        std::cerr << "mdc2250_export: Cannot open " << inputPath << "." << std::endl;
+        return 1;
+    }
+    ColumnWriter writer;
+    if (!writer.open(outputPath)) {
+        std::cerr << "mdc2250_export: Cannot create " << outputPath << "." << std::endl;
+        return 1;
+    }
+
+    // input bytes a wave may hold if every frame is decoded into a row
+    size_t waveInput=memory/ROW_BYTES*MIN_ROW_FRAME;
+    threads=std::max<size_t>(std::min(threads,waveInput/MIN_CHUNK_SIZE),1);
+    chunkSize=std::max(std::min(chunkSize,waveInput/threads),MIN_CHUNK_SIZE);
+
+    ChunkReader reader(input,chunkSize);
+    reader.detect();
+    std::vector<Chunk> wave(threads);
+    boost::int64_t carried[column::COUNT]={0};
+    bool more=true;
+    while (more) {
+        size_t count=0;
+        while ((count<threads)&&(more=reader.next(wave[count])))
+            count++;
+        if (count==0)
+            break;
+
+        runWave(wave,count,&decodeChunk);
+        for (size_t i=0; i<count; i++)
+            stitchChunk(wave[i],carried);
+        runWave(wave,count,&encodeChunk);
+        for (size_t i=0; i<count; i++) {
+            for (size_t j=0; j<wave[i].blocks.size(); j++)
+                if (!writer.write(wave[i].blocks[j])) {
+                    std::cerr << "mdc2250_export: Cannot write " << outputPath << "." << std::endl;
+                    return 1;
+                }
+            wave[i].blocks.clear();
+        }
+    }
+
+    if (reader.isCorrupt()) {
+        std::cerr << "mdc2250_export: " << inputPath << " is corrupt." << std::endl;
+        return 1;
+    }
+    boost::uint64_t rows=writer.rows();
+    if (!writer.close()) {
+        std::cerr << "mdc2250_export: Cannot write " << outputPath << "." << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << rows << " rows from " << (reader.isCapture() ? "capture " : "raw dump ")
+              << inputPath << " to " << outputPath << "." << std::endl;
+    return 0;
+}
+
+int printRange(double from, double to, const std::string &path) {
+    ColumnReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "mdc2250_export: " << path << (reader.isCorrupt() ? " is corrupt." : " is not a column file.")
+                  << std::endl;
+        return 1;
+    }
+    ColumnSet set;
+    if (!reader.readRange(toMicroseconds(from),toMicroseconds(to),set)) {
+        std::cerr << "mdc2250_export: " << path << " is corrupt." << std::endl;
+        return 1;
+    }
+    for (int c=0; c<column::COUNT; c++)
+        std::cout << (c ? "," : "") << columnName(c);
+    std::cout << "\n";
+    for (size_t row=0; row<set.rows(); row++) {
+        for (int c=0; c<column::COUNT; c++)
+            std::cout << (c ? "," : "") << set.values[c][row];
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+void usage() {
+    std::cerr << "Usage: mdc2250_export [-j threads] [-c chunk MB] [-m memory MB] <input> <output.mdct>\n"
+              << "       mdc2250_export -r <from s> <to s> <input.mdct>" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int threads=std::max((int)boost::thread::hardware_concurrency(),1);
+    int chunkMB=4;
+    int memoryMB=256;
+    std::vector<std::string> arguments;
+    for (int i=1; i<argc; i++) {
+        std::string arg=argv[i];
+        if ((arg=="-r")&&(i+3<argc))
+            return printRange(std::atof(argv[i+1]),std::atof(argv[i+2]),argv[i+3]);
+        else if ((arg=="-j")&&(i+1<argc))
+            threads=std::atoi(argv[++i]);
+        else if ((arg=="-c")&&(i+1<argc))
+            chunkMB=std::atoi(argv[++i]);
+        else if ((arg=="-m")&&(i+1<argc))
+            memoryMB=std::atoi(argv[++i]);
+        else
+            arguments.push_back(arg);
+    }
+    if ((arguments.size()!=2)||(arguments[0][0]=='-')||(threads<=0)||(chunkMB<=0)||(memoryMB<=0)) {
+        usage();
+        return 1;
+    }
+    return convert(arguments[0],arguments[1],(size_t)threads,(size_t)chunkMB*1024*1024,
+                   (size_t)memoryMB*1024*1024);
+}
@@ -0,0 +1,104 @@
+#include "mdc2250/mdc2250_keepalive.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <cstring>
+#include <boost/bind.hpp>
+using namespace mdc2250;
+
+/***** WatchdogKeepalive Class Functions *****/
+
+WatchdogKeepalive::WatchdogKeepalive(SendFunction sendFunction)
+    : send(sendFunction), watchdogPeriod(0), lastCommandTime(0),
+      jitterSum(0) {
+    std::memset(&stats,0,sizeof(stats));
+}
+
+WatchdogKeepalive::~WatchdogKeepalive() {
+    stop();
+}
+
+void WatchdogKeepalive::start(long watchdogMs, const KeepaliveOptions &newOptions) {
+    stop();
+    if (watchdogMs<=0)
+        return;
+
+    options=newOptions;
+    if ((options.resendFraction<=0)||(options.resendFraction>=1))
+        options.resendFraction=0.5;
+    watchdogPeriod=watchdogMs/1000.0;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        std::memset(&stats,0,sizeof(stats));
+        jitterSum=0;
+    }
+    timer.reset();
+    thread.reset(new boost::thread(boost::bind(&WatchdogKeepalive::run,this)));
+}
+
+void WatchdogKeepalive::stop() {
+    if (!thread)
+        return;
+    timer.cancel();
+    thread->join();
+    thread.reset();
+}
+
+bool WatchdogKeepalive::isRunning() {
+    return thread.get()!=NULL;
+}
+
+void WatchdogKeepalive::commandSent(const std::string &cmd) {
+    double now=monotonicTime();
+    boost::mutex::scoped_lock lock(mutex);
+    recordGap(now);
+    lastCommand=cmd;
+    lastCommandTime=now;
+}
+
+KeepaliveStats WatchdogKeepalive::getStats() {
+    boost::mutex::scoped_lock lock(mutex);
+    KeepaliveStats result=stats;
+    result.meanJitter=(stats.wakeups>0) ? jitterSum/stats.wakeups : 0.0;
+    return result;
+}
+
+// must be called with mutex held
+void WatchdogKeepalive::recordGap(double now) {
+    if (lastCommand.empty())
+        return;
+    double gap=now-lastCommandTime;
+    if (gap>stats.maxCommandGap)
+        stats.maxCommandGap=gap;
+    if (gap>options.nearMissFraction*watchdogPeriod)
+        stats.nearMisses++;
+}
+
+void WatchdogKeepalive::run() {
+    applyRealtimeOptions(options.realtime);
+
+    double interval=options.resendFraction*watchdogPeriod;
+    double deadline=monotonicTime()+interval;
+    while (timer.waitUntil(deadline)) {
+        double now=monotonicTime();
+        std::string cmd;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            double jitter=now-deadline;
+            stats.wakeups++;
+            jitterSum+=jitter;
+            if (jitter>stats.maxJitter)
+                stats.maxJitter=jitter;
+
+            if (!lastCommand.empty()&&(now-lastCommandTime>=interval)) {
+                // nothing was sent since the last deadline - resend
+                cmd=lastCommand;
+                recordGap(now);
+                lastCommandTime=now;
+                stats.resends++;
+            }
+            // the next deadline is always relative to the latest command
+            deadline=(lastCommand.empty() ? now : lastCommandTime)+interval;
+        }
+        if (!cmd.empty())
+            send(cmd);
+    }
+}
@@ -0,0 +1,116 @@
+#include "mdc2250/mdc2250_link.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+using namespace mdc2250;
+
+/***** Inline Functions *****/
+
+// Counts complete ?TRN responses in data
+inline int countResponses(const std::string &data) {
+    int count=0;
+    size_t pos=data.find("TRN=");
+    while (pos!=std::string::npos) {
+        size_t end=data.find('\r',pos);
+        if (end==std::string::npos)
+            break;
+        count++;
+        pos=data.find("TRN=",end);
+    }
+    return count;
+}
+
+/***** Link Functions *****/
+
+bool mdc2250::isUsbCdcPort(const std::string &port) {
+#if defined(_WIN32)
+    return false;
+#else
+    // resolve /dev/serial/by-id/... and similar links to the tty itself
+    std::string device=port;
+    char resolved[PATH_MAX];
+    if (realpath(port.c_str(),resolved)!=NULL)
+        device=resolved;
+    std::string name=device.substr(device.rfind('/')+1);
+    if (name.compare(0,6,"ttyACM")==0)
+        return true;
+
+    std::string driverLink="/sys/class/tty/"+name+"/device/driver";
+    char driver[PATH_MAX];
+    ssize_t length=readlink(driverLink.c_str(),driver,sizeof(driver)-1);
+    if (length<=0)
+        return false;
+    driver[length]='\0';
+    const char *base=std::strrchr(driver,'/');
+    return std::strcmp(base ? base+1 : driver,"cdc_acm")==0;
+#endif
+}
+
+bool mdc2250::probeLink(Transport &transport, int roundTrips, int burst, LinkInfo &info) {
+    info.roundTrips=0;
+    info.rttMin=info.rttMean=info.rttMax=0.0;
+    info.burstBytes=0;
+    info.bytesPerSecond=0.0;
+
+    // drop anything left over from the handshake
+    transport.read(10000);
+
+    // time single exchanges, reading byte by byte so the response is seen
+    // as soon as it is complete
+    size_t exchangeBytes=0;
+    double total=0.0;
+    for (int i=0; i<roundTrips; i++) {
+        std::string received;
+        double start=monotonicTime();
+        double deadline=start+0.5;
+        transport.write("?TRN\r");
+        while ((countResponses(received)<1)&&(monotonicTime()<deadline))
+            received+=transport.read(1);
+        double rtt=monotonicTime()-start;
+        if (countResponses(received)<1)
+            return false;
+        if (exchangeBytes==0)
+            exchangeBytes=received.length();
+        if ((info.roundTrips==0)||(rtt<info.rttMin))
+            info.rttMin=rtt;
+        info.rttMax=std::max(info.rttMax,rtt);
+        total+=rtt;
+        info.roundTrips++;
+    }
+    if (info.roundTrips>0)
+        info.rttMean=total/info.roundTrips;
+    if (burst<=0)
+        return true;
+
+    // queue the whole burst, then time until every response is in; the
+    // controller answers as fast as the link drains, so this measures the
+    // receive direction
+    std::string requests;
+    for (int i=0; i<burst; i++)
+        requests+="?TRN\r";
+    size_t expected=exchangeBytes>0 ? exchangeBytes*burst : 1;
+    std::string received;
+    double start=monotonicTime();
+    double deadline=start+1.0+expected*0.002;
+    transport.write(requests);
+    int responses=0;
+    while ((responses<burst)&&(monotonicTime()<deadline)) {
+        // ask for what is still expected so a serial read does not sit
+        // out its timeout waiting for bytes that will never come
+        size_t remaining=received.length()<expected ? expected-received.length() : 1;
+        received+=transport.read(std::min<size_t>(remaining,4096));
+        responses=countResponses(received);
+    }
+    double elapsed=monotonicTime()-start;
+    info.burstBytes=received.length();
+    if (elapsed>0.0)
+        info.bytesPerSecond=received.length()/elapsed;
+    return responses==burst;
+}
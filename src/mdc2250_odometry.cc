@@ -0,0 +1,148 @@
+#include "mdc2250/mdc2250_odometry.h"
+#include <cmath>
+#include <cstring>
+using namespace mdc2250;
+
+/***** Inline Functions *****/
+
+// Encoder ticks per revolution - the controller counts all four quadrature edges
+inline double countsPerRevolution(int ppr) {
+    return 4.0 * ppr;
+}
+
+// Difference of two 32 bit counter values, correct across wraparound
+inline long counterDelta(long current, long previous) {
+    return (long)(int)((unsigned int)current - (unsigned int)previous);
+}
+
+/***** OdometryEstimator Class Functions *****/
+
+OdometryEstimator::OdometryEstimator() {
+    // MDC2250 factory default of 100 PPR
+    setEncoderPPR(1, 100);
+    setEncoderPPR(2, 100);
+    reset();
+}
+
+bool OdometryEstimator::configure(const OdometryConfig &newConfig) {
+    // the geometry divides every update
+    if ((newConfig.wheelRadius<=0)||(newConfig.trackWidth<=0))
+        return false;
+    config=newConfig;
+    if (config.gearRatio<=0)
+        config.gearRatio=1.0;
+    if ((config.velocityFilter<0)||(config.velocityFilter>=1))
+        config.velocityFilter=0.0;
+    reset();
+    return true;
+}
+
+void OdometryEstimator::setEncoderPPR(int channel, int ppr) {
+    if ((channel<1)||(channel>2)||(ppr<1))
+        return;
+    radiansPerCount[channel-1]=2.0*M_PI/countsPerRevolution(ppr);
+}
+
+void OdometryEstimator::updateAbsolute(long count1, long count2, double t) {
+    if (source==_NONE)
+        source=_ABSOLUTE;
+    if (source!=_ABSOLUTE)
+        return;
+
+    if (!haveBaseline) {
+        // first sample after start up or a counter reset - no motion yet
+        lastCount[0]=count1;
+        lastCount[1]=count2;
+        haveBaseline=true;
+        state.time=t;
+        haveTime=true;
+        return;
+    }
+
+    long delta1=counterDelta(count1,lastCount[0]);
+    long delta2=counterDelta(count2,lastCount[1]);
+    lastCount[0]=count1;
+    lastCount[1]=count2;
+    integrate(delta1,delta2,t);
+}
+
+void OdometryEstimator::updateRelative(long delta1, long delta2, double t) {
+    if (source==_NONE)
+        source=_RELATIVE;
+    if (source!=_RELATIVE)
+        return;
+    integrate(delta1,delta2,t);
+}
+
+void OdometryEstimator::notifyCounterReset() {
+    haveBaseline=false;
+}
+
+void OdometryEstimator::reset() {
+    std::memset(&state,0,sizeof(state));
+    lastCount[0]=lastCount[1]=0;
+    haveBaseline=false;
+    haveTime=false;
+    haveAnchor=false;
+    anchorTime=0;
+    anchorPosition[0]=anchorPosition[1]=0;
+    anchorVelocity[0]=anchorVelocity[1]=0;
+    source=_NONE;
+}
+
+void OdometryEstimator::integrate(long delta1, long delta2, double t) {
+    // samples sharing a time extend one interval: measure velocities from
+    // the last sample before it, so every frame of a read is counted
+    if (haveTime&&(t!=state.time)) {
+        haveAnchor=true;
+        anchorTime=state.time;
+        for (int ii=0; ii<2; ii++) {
+            anchorPosition[ii]=state.wheelPosition[ii];
+            anchorVelocity[ii]=state.wheelVelocity[ii];
+        }
+    }
+    double dt=haveAnchor ? t-anchorTime : 0.0;
+    int left=(config.leftChannel==2) ? 1 : 0;
+    int right=1-left;
+    double angle[2];
+    angle[0]=delta1*radiansPerCount[0]/config.gearRatio;
+    angle[1]=delta2*radiansPerCount[1]/config.gearRatio;
+    // inverted encoders count backwards when their wheel drives forward
+    if (config.invertLeft)
+        angle[left]=-angle[left];
+    if (config.invertRight)
+        angle[right]=-angle[right];
+
+    // wheel positions and velocities
+    for (int ii=0; ii<2; ii++) {
+        state.wheelPosition[ii]+=angle[ii];
+        if (dt>0) {
+            double velocity=(state.wheelPosition[ii]-anchorPosition[ii])/dt;
+            state.wheelVelocity[ii]=config.velocityFilter*anchorVelocity[ii]
+                +(1.0-config.velocityFilter)*velocity;
+        }
+    }
+
+    // differential drive pose
+    double leftDist=angle[left]*config.wheelRadius;
+    double rightDist=angle[right]*config.wheelRadius;
+
+    double distance=(leftDist+rightDist)/2.0;
+    double rotation=(rightDist-leftDist)/config.trackWidth;
+    // integrate along the mid-point heading of the step
+    double heading=state.theta+rotation/2.0;
+    state.x+=distance*std::cos(heading);
+    state.y+=distance*std::sin(heading);
+    state.theta=std::atan2(std::sin(state.theta+rotation),std::cos(state.theta+rotation));
+
+    if (dt>0) {
+        double leftVel=state.wheelVelocity[left]*config.wheelRadius;
+        double rightVel=state.wheelVelocity[right]*config.wheelRadius;
+        state.linearVelocity=(leftVel+rightVel)/2.0;
+        state.angularVelocity=(rightVel-leftVel)/config.trackWidth;
+    }
+
+    state.time=t;
+    haveTime=true;
+    state.updates++;
+}
@@ -0,0 +1,160 @@
+#include "mdc2250/mdc2250_realtime.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <stdint.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#endif
+
+using namespace mdc2250;
+
+/***** Realtime Functions *****/
+
+bool mdc2250::applyRealtimeOptions(const RealtimeOptions &options) {
+    bool ok=true;
+#if defined(__linux__)
+    if (options.lockMemory) {
+        if (mlockall(MCL_CURRENT|MCL_FUTURE)!=0) {
+            std::cout << "MDC2250: Failed to lock memory: " << std::strerror(errno) << std::endl;
+            ok=false;
+        }
+    }
+    if (options.cpu>=0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options.cpu,&cpus);
+        int result=pthread_setaffinity_np(pthread_self(),sizeof(cpus),&cpus);
+        if (result!=0) {
+            std::cout << "MDC2250: Failed to set CPU affinity: " << std::strerror(result) << std::endl;
+            ok=false;
+        }
+    }
+    if (options.fifoScheduling) {
+        struct sched_param param;
+        param.sched_priority=options.priority;
+        int result=pthread_setschedparam(pthread_self(),SCHED_FIFO,&param);
+        if (result!=0) {
+            std::cout << "MDC2250: Failed to set SCHED_FIFO: " << std::strerror(result) << std::endl;
+            ok=false;
+        }
+    }
+#else
+    if (options.lockMemory||(options.cpu>=0)||options.fifoScheduling) {
+        std::cout << "MDC2250: Realtime options are not supported on this platform." << std::endl;
+        ok=false;
+    }
+#endif
+    return ok;
+}
+
+/***** DeadlineTimer Class Functions *****/
+
+#if defined(__linux__)
+
+DeadlineTimer::DeadlineTimer() : cancelled(false) {
+    timerFd=timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC);
+    cancelFd=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+    if ((timerFd<0)||(cancelFd<0))
+        std::cout << "MDC2250: Failed to create timer: " << std::strerror(errno) << std::endl;
+}
+
+DeadlineTimer::~DeadlineTimer() {
+    if (timerFd>=0)
+        close(timerFd);
+    if (cancelFd>=0)
+        close(cancelFd);
+}
+
+bool DeadlineTimer::waitUntil(double deadline) {
+    if (cancelled)
+        return false;
+
+    struct itimerspec spec;
+    std::memset(&spec,0,sizeof(spec));
+    double seconds=std::floor(deadline);
+    spec.it_value.tv_sec=(time_t)seconds;
+    spec.it_value.tv_nsec=(long)((deadline-seconds)*1.0e9);
+    // a zero expiry disarms the timer, so never ask for the epoch itself
+    if ((spec.it_value.tv_sec==0)&&(spec.it_value.tv_nsec==0))
+        spec.it_value.tv_nsec=1;
+    if (timerfd_settime(timerFd,TFD_TIMER_ABSTIME,&spec,NULL)!=0)
+        return false;
+
+    struct pollfd fds[2];
+    fds[0].fd=timerFd;
+    fds[0].events=POLLIN;
+    fds[1].fd=cancelFd;
+    fds[1].events=POLLIN;
+    while (true) {
+        int result=poll(fds,2,-1);
+        if (result<0) {
+            if (errno==EINTR)
+                continue;
+            return false;
+        }
+        if (fds[1].revents&POLLIN)
+            return false;
+        if (fds[0].revents&POLLIN) {
+            uint64_t expirations;
+            ssize_t n=read(timerFd,&expirations,sizeof(expirations));
+            (void)n;
+            return !cancelled;
+        }
+    }
+}
+
+void DeadlineTimer::cancel() {
+    cancelled=true;
+    uint64_t one=1;
+    ssize_t n=write(cancelFd,&one,sizeof(one));
+    (void)n;
+}
+
+void DeadlineTimer::reset() {
+    uint64_t value;
+    ssize_t n=read(cancelFd,&value,sizeof(value));
+    (void)n;
+    cancelled=false;
+}
+
+#else
+
+DeadlineTimer::DeadlineTimer() : cancelled(false) {
+}
+
+DeadlineTimer::~DeadlineTimer() {
+}
+
+bool DeadlineTimer::waitUntil(double deadline) {
+    boost::mutex::scoped_lock lock(mutex);
+    while (!cancelled) {
+        double remaining=deadline-monotonicTime();
+        if (remaining<=0)
+            return true;
+        condition.timed_wait(lock,boost::posix_time::microseconds((long)(remaining*1.0e6)));
+    }
+    return false;
+}
+
+void DeadlineTimer::cancel() {
+    boost::mutex::scoped_lock lock(mutex);
+    cancelled=true;
+    condition.notify_all();
+}
+
+void DeadlineTimer::reset() {
+    boost::mutex::scoped_lock lock(mutex);
+    cancelled=false;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include "mdc2250/mdc2250_reflex.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <cstring>
+using namespace mdc2250;
+
+/***** FaultReflex Class Functions *****/
+
+FaultReflex::FaultReflex(ActionFunction actionFunction)
+    : action(actionFunction), ruleCount(0), previousFlags(0), latencySum(0) {
+    std::memset(&stats,0,sizeof(stats));
+}
+
+int FaultReflex::addRule(const FaultRule &rule) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (ruleCount>=MAX_RULES)
+        return -1;
+    rules[ruleCount]=rule;
+    return ruleCount++;
+}
+
+void FaultReflex::clearRules() {
+    boost::mutex::scoped_lock lock(mutex);
+    ruleCount=0;
+}
+
+void FaultReflex::update(int flags, double arrivalTime) {
+    boost::mutex::scoped_lock lock(mutex);
+    stats.evaluations++;
+    int set=flags&~previousFlags;
+    int cleared=previousFlags&~flags;
+    previousFlags=flags;
+    if ((set|cleared)==0)
+        return;
+    stats.edges++;
+
+    for (int ii=0; ii<ruleCount; ii++) {
+        const FaultRule &rule=rules[ii];
+        if ((rule.mask&(rule.onSet ? set : cleared))==0)
+            continue;
+        bool result=action(rule);
+        double latency=monotonicTime()-arrivalTime;
+        stats.fired++;
+        if (!result)
+            stats.failed++;
+        stats.lastLatency=latency;
+        latencySum+=latency;
+        if (latency>stats.maxLatency)
+            stats.maxLatency=latency;
+    }
+}
+
+ReflexStats FaultReflex::getStats() {
+    boost::mutex::scoped_lock lock(mutex);
+    ReflexStats result=stats;
+    result.meanLatency=(stats.fired>0) ? latencySum/stats.fired : 0.0;
+    return result;
+}
@@ -0,0 +1,223 @@
+#include "mdc2250/mdc2250_scheduler.h"
+#include "mdc2250/mdc2250_clock.h"
+#include "mdc2250/mdc2250_trace.h"
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <boost/bind.hpp>
+using namespace mdc2250;
+using namespace commandpriority;
+
+/***** Command Classification *****/
+
+CommandPriority mdc2250::classifyCommand(const std::string &cmd) {
+    // skip leading carriage returns used to flush the controller's buffer
+    size_t start=cmd.find_first_not_of("\r");
+    if (start==std::string::npos)
+        return _QUERY;
+    if ((cmd.compare(start,3,"!EX")==0)||(cmd.compare(start,3,"!MG")==0))
+        return _SAFETY;
+    switch (cmd[start]) {
+        case '!':
+            return _MOTION;
+        case '^':
+        case '%':
+            return _CONFIG;
+        default:
+            return _QUERY;
+    }
+}
+
+/***** CommandScheduler Class Functions *****/
+
+CommandScheduler::CommandScheduler(WriteFunction writeFunction)
+    : write(writeFunction), running(false), safetyPending(0), writing(false), stopping(false),
+      safetyWaitSum(0) {
+    std::memset(&stats,0,sizeof(stats));
+}
+
+CommandScheduler::~CommandScheduler() {
+    stop();
+}
+
+void CommandScheduler::start(const SchedulerOptions &newOptions) {
+    stop();
+    options=newOptions;
+    {
+        boost::mutex::scoped_lock lock(queueMutex);
+        stopping=false;
+    }
+    running=true;
+    thread.reset(new boost::thread(boost::bind(&CommandScheduler::run,this)));
+}
+
+void CommandScheduler::stop() {
+    if (!thread)
+        return;
+    {
+        boost::mutex::scoped_lock lock(queueMutex);
+        stopping=true;
+    }
+    queueCondition.notify_all();
+    thread->join();
+    thread.reset();
+    running=false;
+}
+
+bool CommandScheduler::send(const std::string &cmd, CommandPriority priority, bool purgeMotion) {
+    if (priority==_SAFETY)
+        return sendSafety(cmd,purgeMotion);
+    if (!running)
+        return writeDirect(cmd);
+
+    QueuedCommand item;
+    item.cmd=cmd;
+    item.priority=priority;
+    item.enqueueTime=monotonicTime();
+    trace::instant("enqueue",cmd.data(),cmd.data()+cmd.length(),priority);
+    {
+        boost::mutex::scoped_lock lock(queueMutex);
+        // the writer thread may already have written its last batch
+        if (stopping)
+            return false;
+        queue.push_back(item);
+        stats.queued[priority]++;
+    }
+    queueCondition.notify_all();
+    return true;
+}
+
+bool CommandScheduler::waitUntilWritten(double timeout) {
+    boost::system_time deadline=boost::get_system_time()
+        +boost::posix_time::microseconds((long)(timeout*1.0e6));
+    boost::mutex::scoped_lock lock(queueMutex);
+    while (!queue.empty()||writing)
+        if (!queueCondition.timed_wait(lock,deadline))
+            return queue.empty()&&!writing;
+    return true;
+}
+
+SchedulerStats CommandScheduler::getStats() {
+    boost::mutex::scoped_lock lock(queueMutex);
+    SchedulerStats result=stats;
+    result.meanSafetyWait=(stats.safetyCommands>0) ? safetyWaitSum/stats.safetyCommands : 0.0;
+    return result;
+}
+
+bool CommandScheduler::sendSafety(const std::string &cmd, bool purgeMotion) {
+    double start=monotonicTime();
+    safetyPending++;
+
+    // a stop makes every queued motion command obsolete, the writer thread
+    // holds back from here on so none of them slips out first
+    if (purgeMotion) {
+        boost::mutex::scoped_lock lock(queueMutex);
+        std::deque<QueuedCommand>::iterator it=queue.begin();
+        while (it!=queue.end()) {
+            if (it->priority==_MOTION) {
+                it=queue.erase(it);
+                stats.purged++;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool result;
+    double acquired, done;
+    {
+        boost::mutex::scoped_lock lock(portMutex);
+        acquired=monotonicTime();
+        trace::Span span("writeSafety",cmd);
+        result=write(cmd);
+        done=monotonicTime();
+    }
+    safetyPending--;
+
+    {
+        boost::mutex::scoped_lock lock(queueMutex);
+        double wait=acquired-start;
+        stats.safetyCommands++;
+        stats.written[_SAFETY]++;
+        stats.writes++;
+        if (!result)
+            stats.writeErrors++;
+        stats.lastSafetyWait=wait;
+        safetyWaitSum+=wait;
+        if (wait>stats.maxSafetyWait)
+            stats.maxSafetyWait=wait;
+        if (done-start>stats.maxSafetyLatency)
+            stats.maxSafetyLatency=done-start;
+    }
+    // release the writer thread if it held back for us
+    queueCondition.notify_all();
+    return result;
+}
+
+bool CommandScheduler::writeDirect(const std::string &cmd) {
+    bool result;
+    {
+        boost::mutex::scoped_lock lock(portMutex);
+        trace::Span span("writeDirect",cmd);
+        result=write(cmd);
+    }
+    boost::mutex::scoped_lock lock(queueMutex);
+    stats.writes++;
+    if (!result)
+        stats.writeErrors++;
+    return result;
+}
+
+void CommandScheduler::run() {
+    applyRealtimeOptions(options.realtime);
+    trace::setThreadName("scheduler");
+
+    std::string batch;
+    // class and enqueue time of each command in the batch
+    std::vector<std::pair<CommandPriority,double> > written;
+    while (true) {
+        batch.clear();
+        written.clear();
+        {
+            boost::mutex::scoped_lock lock(queueMutex);
+            // wait for work, and for any safety command to get the port first
+            while (queue.empty()||(safetyPending>0)) {
+                // only exit once everything queued has been written
+                if (queue.empty()&&stopping)
+                    return;
+                queueCondition.wait(lock);
+            }
+
+            // combine whole commands into one write, in the order sent
+            do {
+                batch+=queue.front().cmd;
+                written.push_back(std::make_pair(queue.front().priority,queue.front().enqueueTime));
+                queue.pop_front();
+            } while (!queue.empty()&&(batch.length()+queue.front().cmd.length()<=options.maxBatch));
+            writing=true;
+        }
+
+        bool result;
+        {
+            boost::mutex::scoped_lock lock(portMutex);
+            trace::Span span("write",batch,(long)written.size());
+            result=write(batch);
+        }
+
+        double now=monotonicTime();
+        boost::mutex::scoped_lock lock(queueMutex);
+        writing=false;
+        stats.writes++;
+        if (!result)
+            stats.writeErrors++;
+        for (size_t ii=0; ii<written.size(); ii++) {
+            CommandPriority priority=written[ii].first;
+            stats.written[priority]++;
+            if (now-written[ii].second>stats.maxQueueDelay[priority])
+                stats.maxQueueDelay[priority]=now-written[ii].second;
+        }
+        // wake waitUntilWritten
+        if (queue.empty())
+            queueCondition.notify_all();
+    }
+}
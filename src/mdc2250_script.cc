@@ -0,0 +1,80 @@
+#include "mdc2250/mdc2250_script.h"
+#include <fstream>
+#include <iostream>
+using namespace mdc2250;
+
+/***** Inline Functions *****/
+
+// Returns the value of a hex digit, -1 if c is not one
+inline int hexDigit(char c) {
+    if ((c>='0')&&(c<='9'))
+        return c-'0';
+    if ((c>='A')&&(c<='F'))
+        return c-'A'+10;
+    if ((c>='a')&&(c<='f'))
+        return c-'a'+10;
+    return -1;
+}
+
+/***** Script Loading *****/
+
+bool mdc2250::parseScriptHex(std::istream &input, std::vector<std::string> &records) {
+    records.clear();
+    std::string line;
+    size_t number=0;
+    bool ended=false;
+    while (std::getline(input,line)) {
+        number++;
+        // tolerate DOS line endings and trailing blanks
+        size_t last=line.find_last_not_of(" \t\r\n");
+        if (last==std::string::npos)
+            continue;
+        line.erase(last+1);
+        if (ended) {
+            std::cout << "MicroBasic: Data after the end of file record on line " << number << "." << std::endl;
+            return false;
+        }
+
+        // :LLAAAATT<data>CC, the bytes including the checksum sum to zero
+        if ((line[0]!=':')||(line.length()<11)||(line.length()%2!=1)) {
+            std::cout << "MicroBasic: Malformed record on line " << number << "." << std::endl;
+            return false;
+        }
+        int sum=0;
+        std::vector<int> bytes;
+        for (size_t i=1; i<line.length(); i+=2) {
+            int high=hexDigit(line[i]), low=hexDigit(line[i+1]);
+            if ((high<0)||(low<0)) {
+                std::cout << "MicroBasic: Malformed record on line " << number << "." << std::endl;
+                return false;
+            }
+            bytes.push_back(high*16+low);
+            sum+=bytes.back();
+        }
+        if ((size_t)bytes[0]+5!=bytes.size()) {
+            std::cout << "MicroBasic: Wrong record length on line " << number << "." << std::endl;
+            return false;
+        }
+        if ((sum&0xff)!=0) {
+            std::cout << "MicroBasic: Checksum error on line " << number << "." << std::endl;
+            return false;
+        }
+        if (bytes[3]==1)
+            ended=true;
+        records.push_back(line);
+    }
+    if (!ended) {
+        std::cout << "MicroBasic: Script has no end of file record." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool mdc2250::loadScriptHex(const std::string &path, std::vector<std::string> &records) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        std::cout << "MicroBasic: Cannot open " << path << "." << std::endl;
+        return false;
+    }
+    return parseScriptHex(file,records);
+}
@@ -0,0 +1,255 @@
+#include "mdc2250/mdc2250_shm.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <boost/atomic.hpp>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace mdc2250;
+
+/***** Segment Layout *****/
+
+namespace mdc2250 {
+
+// A ring slot; lock is 2*(sequence+1) once the sample is complete and odd
+// while the publisher is writing it.  Slots start on their own cache line,
+// which holds in the segment since it is mapped at a page boundary.
+struct MDC2250_ALIGNED(64) TelemetrySlot {
+    boost::atomic<boost::uint64_t> lock;
+    TelemetrySample sample;
+};
+
+struct TelemetrySegment {
+    boost::uint32_t magic;
+    boost::uint32_t version;
+    boost::uint32_t sampleSize;
+    boost::uint32_t capacity;
+    boost::atomic<boost::uint64_t> published; //!< number of samples published
+    TelemetrySlot slots[1]; //!< capacity slots follow
+};
+
+}
+
+inline size_t segmentSize(size_t capacity) {
+    return sizeof(TelemetrySegment)+(capacity-1)*sizeof(TelemetrySlot);
+}
+
+/***** TelemetryPublisher Class Functions *****/
+
+TelemetryPublisher::TelemetryPublisher() : segment(NULL), size(0) {
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+    close();
+}
+
+#if !defined(_WIN32)
+
+bool TelemetryPublisher::open(const std::string &segmentName, size_t history) {
+    close();
+    if (history<1)
+        history=1;
+
+    // replace any stale segment so readers never see a half initialized one
+    shm_unlink(segmentName.c_str());
+    int fd=shm_open(segmentName.c_str(),O_CREAT|O_EXCL|O_RDWR,0644);
+    if (fd<0) {
+        std::cout << "MDC2250: Failed to create shared memory " << segmentName << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    size_t bytes=segmentSize(history);
+    if (ftruncate(fd,bytes)!=0) {
+        std::cout << "MDC2250: Failed to size shared memory: " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+    void *memory=mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    ::close(fd);
+    if (memory==MAP_FAILED) {
+        std::cout << "MDC2250: Failed to map shared memory: " << std::strerror(errno) << std::endl;
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    segment=static_cast<TelemetrySegment*>(memory);
+    new (&segment->published) boost::atomic<boost::uint64_t>(0);
+    for (size_t ii=0; ii<history; ii++)
+        new (&segment->slots[ii].lock) boost::atomic<boost::uint64_t>(0);
+    segment->sampleSize=sizeof(TelemetrySample);
+    segment->capacity=history;
+    segment->version=TELEMETRY_SHM_VERSION;
+    // readers check the magic last
+    boost::atomic_thread_fence(boost::memory_order_release);
+    segment->magic=TELEMETRY_SHM_MAGIC;
+
+    name=segmentName;
+    size=bytes;
+    return true;
+}
+
+void TelemetryPublisher::close() {
+    if (segment==NULL)
+        return;
+    munmap(segment,size);
+    shm_unlink(name.c_str());
+    segment=NULL;
+}
+
+#else
+
+bool TelemetryPublisher::open(const std::string &segmentName, size_t history) {
+    std::cout << "MDC2250: Shared memory telemetry is not supported on this platform." << std::endl;
+    return false;
+}
+
+void TelemetryPublisher::close() {
+}
+
+#endif
+
+void TelemetryPublisher::publish(const mdc2250_raw_status &status, int query, double time) {
+    if (segment==NULL)
+        return;
+    boost::uint64_t sequence=segment->published.load(boost::memory_order_relaxed);
+    TelemetrySlot &slot=segment->slots[sequence%segment->capacity];
+
+    slot.lock.store(2*sequence+1,boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+    slot.sample.sequence=sequence;
+    slot.sample.time=time;
+    slot.sample.query=query;
+    slot.sample.status=status;
+    slot.lock.store(2*(sequence+1),boost::memory_order_release);
+
+    segment->published.store(sequence+1,boost::memory_order_release);
+}
+
+/***** TelemetryReader Class Functions *****/
+
+// Reads of a slot that stays locked give up after this many attempts
+static const int MAX_READ_RETRIES = 100000;
+
+TelemetryReader::TelemetryReader() : segment(NULL), size(0) {
+}
+
+TelemetryReader::~TelemetryReader() {
+    close();
+}
+
+#if !defined(_WIN32)
+
+bool TelemetryReader::open(const std::string &name) {
+    close();
+    int fd=shm_open(name.c_str(),O_RDONLY,0);
+    if (fd<0)
+        return false;
+    struct stat info;
+    if ((fstat(fd,&info)!=0)||((size_t)info.st_size<sizeof(TelemetrySegment))) {
+        ::close(fd);
+        return false;
+    }
+    void *memory=mmap(NULL,info.st_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if (memory==MAP_FAILED)
+        return false;
+
+    const TelemetrySegment *candidate=static_cast<const TelemetrySegment*>(memory);
+    bool valid=(candidate->magic==TELEMETRY_SHM_MAGIC);
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    valid=valid&&(candidate->version==TELEMETRY_SHM_VERSION)
+        &&(candidate->sampleSize==sizeof(TelemetrySample))
+        &&(candidate->capacity>0)
+        &&(segmentSize(candidate->capacity)<=(size_t)info.st_size);
+    if (!valid) {
+        std::cout << "MDC2250: Shared memory " << name << " has an unsupported layout." << std::endl;
+        munmap(memory,info.st_size);
+        return false;
+    }
+    segment=candidate;
+    size=info.st_size;
+    return true;
+}
+
+void TelemetryReader::close() {
+    if (segment==NULL)
+        return;
+    munmap(const_cast<TelemetrySegment*>(segment),size);
+    segment=NULL;
+}
+
+#else
+
+bool TelemetryReader::open(const std::string &name) {
+    return false;
+}
+
+void TelemetryReader::close() {
+}
+
+#endif
+
+boost::uint64_t TelemetryReader::count() const {
+    if (segment==NULL)
+        return 0;
+    return segment->published.load(boost::memory_order_acquire);
+}
+
+bool TelemetryReader::readSample(boost::uint64_t sequence, TelemetrySample &sample) const {
+    const TelemetrySlot &slot=segment->slots[sequence%segment->capacity];
+    boost::uint64_t expected=2*(sequence+1);
+    // a publisher that died in the middle of a write leaves the slot odd
+    for (int retry=0; retry<MAX_READ_RETRIES; retry++) {
+        boost::uint64_t before=slot.lock.load(boost::memory_order_acquire);
+        if (before&1)
+            continue; // being written, the publisher finishes quickly
+        if (before!=expected)
+            return false; // overwritten by a newer sample or not written yet
+        std::memcpy(&sample,&slot.sample,sizeof(sample));
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        if (slot.lock.load(boost::memory_order_relaxed)==before)
+            return true;
+    }
+    return false;
+}
+
+bool TelemetryReader::readLatest(TelemetrySample &sample) const {
+    if (segment==NULL)
+        return false;
+    for (int retry=0; retry<MAX_READ_RETRIES; retry++) {
+        boost::uint64_t published=count();
+        if (published==0)
+            return false;
+        if (readSample(published-1,sample))
+            return true;
+        // lapped while copying - try the newest sample again, unless
+        // nothing new was published and the slot is stuck
+        if (count()==published)
+            return false;
+    }
+    return false;
+}
+
+size_t TelemetryReader::readHistory(std::vector<TelemetrySample> &samples, size_t maxSamples) const {
+    samples.clear();
+    if (segment==NULL)
+        return 0;
+    boost::uint64_t published=count();
+    if (maxSamples>segment->capacity)
+        maxSamples=segment->capacity;
+    samples.reserve(maxSamples);
+    TelemetrySample sample;
+    for (boost::uint64_t ii=0; (ii<maxSamples)&&(ii<published); ii++) {
+        if (!readSample(published-1-ii,sample))
+            break; // older samples were overwritten meanwhile
+        samples.push_back(sample);
+    }
+    return samples.size();
+}
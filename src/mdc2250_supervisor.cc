@@ -0,0 +1,150 @@
+#include "mdc2250/mdc2250_supervisor.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <boost/bind.hpp>
+using namespace mdc2250;
+
+/***** Inline Functions *****/
+
+inline boost::int64_t toMicroseconds(double time) {
+    return (boost::int64_t)(time*1.0e6);
+}
+
+/***** ConnectionSupervisor Class Functions *****/
+
+ConnectionSupervisor::ConnectionSupervisor(ReconnectFunction reconnectFunction)
+    : reconnect(reconnectFunction), error(false), reconnecting(false),
+      lastData(0), telemetryPeriod(0) {
+    std::memset(&stats,0,sizeof(stats));
+}
+
+ConnectionSupervisor::~ConnectionSupervisor() {
+    stop();
+}
+
+void ConnectionSupervisor::start(const SupervisorOptions &newOptions) {
+    stop();
+    options=newOptions;
+    if (options.checkPeriod<=0)
+        options.checkPeriod=0.01;
+    if (options.initialBackoff<=0)
+        options.initialBackoff=0.01;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        std::memset(&stats,0,sizeof(stats));
+    }
+    error=false;
+    lastData=0;
+    timer.reset();
+    thread.reset(new boost::thread(boost::bind(&ConnectionSupervisor::run,this)));
+}
+
+void ConnectionSupervisor::stop() {
+    if (!thread)
+        return;
+    timer.cancel();
+    thread->join();
+    thread.reset();
+}
+
+bool ConnectionSupervisor::isRunning() {
+    return thread.get()!=NULL;
+}
+
+void ConnectionSupervisor::dataReceived(double time) {
+    lastData=toMicroseconds(time);
+}
+
+void ConnectionSupervisor::setTelemetryPeriod(double period) {
+    telemetryPeriod=(period>0) ? toMicroseconds(period) : 0;
+    // give a new plan a full timeout to start flowing
+    if (lastData.load()!=0)
+        lastData=toMicroseconds(monotonicTime());
+}
+
+void ConnectionSupervisor::linkError() {
+    // errors caused by the reconnect itself are not a new loss
+    if (!reconnecting.load())
+        error=true;
+}
+
+void ConnectionSupervisor::commandDropped() {
+    boost::mutex::scoped_lock lock(mutex);
+    stats.dropped++;
+}
+
+void ConnectionSupervisor::setRecoveryCallback(RecoveryCallback callback) {
+    boost::mutex::scoped_lock lock(mutex);
+    recoveryCallback=callback;
+}
+
+SupervisorStats ConnectionSupervisor::getStats() {
+    boost::mutex::scoped_lock lock(mutex);
+    return stats;
+}
+
+void ConnectionSupervisor::run() {
+    double deadline=monotonicTime();
+    while (timer.waitUntil(deadline+=options.checkPeriod)) {
+        double now=monotonicTime();
+        boost::int64_t last=lastData.load();
+        boost::int64_t period=telemetryPeriod.load();
+        // only telemetry has to keep arriving, echoes and replies need not
+        bool silent=(last!=0)&&(period>0)&&(options.silencePeriods>0)
+            &&(toMicroseconds(now)-last>(boost::int64_t)(period*options.silencePeriods)
+                                         +toMicroseconds(options.silenceMargin));
+        if (!error.exchange(false)&&!silent)
+            continue;
+
+        std::cout << "MDC2250: Link lost, reconnecting." << std::endl;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stats.losses++;
+        }
+        if (!recover(now))
+            return;
+        deadline=monotonicTime();
+    }
+}
+
+bool ConnectionSupervisor::recover(double detected) {
+    boost::int64_t lastBefore=lastData.load();
+    reconnecting=true;
+    double backoff=options.initialBackoff;
+    for (;;) {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stats.attempts++;
+        }
+        if (reconnect())
+            break;
+        if (!timer.waitUntil(monotonicTime()+backoff)) {
+            reconnecting=false;
+            return false;
+        }
+        backoff=std::min(backoff*2.0,std::max(options.maxBackoff,options.initialBackoff));
+    }
+    double now=monotonicTime();
+    // give the restored telemetry a full timeout to start flowing again
+    if (lastData.load()!=0)
+        lastData=toMicroseconds(now);
+    error=false;
+    reconnecting=false;
+
+    double recovery=now-detected;
+    RecoveryCallback callback;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        stats.recoveries++;
+        stats.lastRecoveryTime=recovery;
+        stats.maxRecoveryTime=std::max(stats.maxRecoveryTime,recovery);
+        stats.lastOutage=(lastBefore!=0) ? now-lastBefore/1.0e6 : recovery;
+        callback=recoveryCallback;
+    }
+    std::cout << "MDC2250: Link restored after " << recovery*1000.0 << " ms." << std::endl;
+    if (callback)
+        callback(recovery);
+    return true;
+}
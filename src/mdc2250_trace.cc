@@ -0,0 +1,255 @@
+#include "mdc2250/mdc2250_trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+using namespace mdc2250;
+
+/***** Thread Buffers *****/
+
+namespace {
+
+//! A thread that recorded into a ring, from event index start on
+struct Owner {
+    boost::uint64_t start; //!< index of the first event of this thread
+    int tid;
+    const char *name; //!< thread name, NULL if unnamed
+};
+
+//! Ring of the events recorded by one thread, written by that thread only
+struct ThreadBuffer {
+    std::vector<trace::Event> events;
+    boost::atomic<boost::uint64_t> head; //!< number of events recorded
+    boost::atomic<boost::uint64_t> cleared; //!< events before this index were cleared
+    std::vector<Owner> owners; //!< owners in order, guarded by registryMutex
+    bool inUse; //!< owned by a running thread, guarded by registryMutex
+
+    explicit ThreadBuffer(size_t size) : events(size), head(0), cleared(0), inUse(true) {}
+
+    //! Hands the ring to a new thread, forgetting owners whose events were overwritten
+    void takeOver(int tid, const char *name) {
+        boost::uint64_t end=head.load();
+        boost::uint64_t oldest=(end>events.size()) ? end-events.size() : 0;
+        while ((owners.size()>1)&&(owners[1].start<=oldest))
+            owners.erase(owners.begin());
+        Owner owner;
+        owner.start=end;
+        owner.tid=tid;
+        owner.name=name;
+        owners.push_back(owner);
+    }
+};
+
+boost::mutex registryMutex; //!< guards buffers, bufferSize, nextTid and ThreadBuffer owners
+std::vector<boost::shared_ptr<ThreadBuffer> > buffers;
+size_t bufferSize=65536;
+int nextTid=1; //!< every thread gets its own tid, even on a reused ring
+
+//! Per thread name and ring, the ring is handed back when the thread exits
+struct ThreadState {
+    const char *name;
+    ThreadBuffer *buffer;
+
+    ThreadState() : name(NULL), buffer(NULL) {}
+    ~ThreadState() {
+        if (buffer) {
+            boost::mutex::scoped_lock lock(registryMutex);
+            buffer->inUse=false;
+        }
+    }
+};
+
+boost::thread_specific_ptr<ThreadState> threadState;
+
+ThreadState* getThreadState() {
+    ThreadState *state=threadState.get();
+    if (!state) {
+        state=new ThreadState;
+        threadState.reset(state);
+    }
+    return state;
+}
+
+ThreadBuffer* getThreadBuffer() {
+    ThreadState *state=getThreadState();
+    if (state->buffer)
+        return state->buffer;
+    boost::mutex::scoped_lock lock(registryMutex);
+    // take over the ring of an exited thread, its events stay until
+    // overwritten and keep the tid and name of the thread that recorded them
+    for (size_t i=0; i<buffers.size(); i++) {
+        if (!buffers[i]->inUse) {
+            buffers[i]->inUse=true;
+            buffers[i]->takeOver(nextTid++,state->name);
+            state->buffer=buffers[i].get();
+            return state->buffer;
+        }
+    }
+    boost::shared_ptr<ThreadBuffer> created(new ThreadBuffer(bufferSize));
+    created->takeOver(nextTid++,state->name);
+    buffers.push_back(created);
+    state->buffer=created.get();
+    return state->buffer;
+}
+
+/*!
+ * Copies the events of a buffer that were not overwritten during the copy.
+ *
+ * \return the index of the first event copied
+ */
+boost::uint64_t snapshot(const ThreadBuffer &buffer, std::vector<trace::Event> &result) {
+    boost::uint64_t size=buffer.events.size();
+    boost::uint64_t end=buffer.head.load(boost::memory_order_acquire);
+    boost::uint64_t begin=std::max(buffer.cleared.load(),(end>size) ? end-size : 0);
+    std::vector<trace::Event> copy;
+    for (boost::uint64_t i=begin; i<end; i++)
+        copy.push_back(buffer.events[i%size]);
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    // the writer may have reused the oldest slots meanwhile, the slot of
+    // the event it records now included
+    boost::uint64_t now=buffer.head.load(boost::memory_order_relaxed);
+    boost::uint64_t valid=(now+1>size) ? now+1-size : 0;
+    for (boost::uint64_t i=begin; i<end; i++)
+        if (i>=valid)
+            result.push_back(copy[i-begin]);
+    return std::max(begin,std::min(valid,end));
+}
+
+void writeEscaped(std::ostream &out, const char *text) {
+    for (; *text; text++) {
+        unsigned char c=*text;
+        if (c=='"'||c=='\\')
+            out << '\\' << c;
+        else if (c=='\r')
+            out << "\\r";
+        else if (c=='\n')
+            out << "\\n";
+        else if (c<0x20)
+            out << "\\u00" << std::hex << std::setw(2) << std::setfill('0') << (int)c
+                << std::dec << std::setfill(' ');
+        else
+            out << c;
+    }
+}
+
+}
+
+/***** Trace Functions *****/
+
+boost::atomic<bool> trace::enabled(false);
+
+void trace::enable(size_t eventsPerThread) {
+    {
+        boost::mutex::scoped_lock lock(registryMutex);
+        bufferSize=std::max(eventsPerThread,(size_t)1);
+    }
+    enabled=true;
+}
+
+void trace::disable() {
+    enabled=false;
+}
+
+void trace::clear() {
+    boost::mutex::scoped_lock lock(registryMutex);
+    for (size_t i=0; i<buffers.size(); i++)
+        buffers[i]->cleared=buffers[i]->head.load();
+}
+
+void trace::setThreadName(const char *name) {
+    ThreadState *state=getThreadState();
+    state->name=name;
+    if (state->buffer) {
+        boost::mutex::scoped_lock lock(registryMutex);
+        state->buffer->owners.back().name=name;
+    }
+}
+
+void trace::record(const char *name, double begin, double duration, long arg,
+                   const char *label, size_t length) {
+    ThreadBuffer *buffer=getThreadBuffer();
+    boost::uint64_t index=buffer->head.load(boost::memory_order_relaxed);
+    Event &event=buffer->events[index%buffer->events.size()];
+    event.begin=begin;
+    event.duration=duration;
+    event.name=name;
+    event.arg=arg;
+    length=std::min(length,sizeof(event.label)-1);
+    if (length>0)
+        std::memcpy(event.label,label,length);
+    event.label[length]='\0';
+    buffer->head.store(index+1,boost::memory_order_release);
+}
+
+std::string trace::toJson() {
+    std::vector<boost::shared_ptr<ThreadBuffer> > current;
+    {
+        boost::mutex::scoped_lock lock(registryMutex);
+        current=buffers;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first=true;
+    std::vector<Event> events;
+    std::vector<Owner> owners;
+    for (size_t i=0; i<current.size(); i++) {
+        const ThreadBuffer &buffer=*current[i];
+        events.clear();
+        boost::uint64_t index=snapshot(buffer,events);
+        // owners are copied after the events, so every copied event has one
+        {
+            boost::mutex::scoped_lock lock(registryMutex);
+            owners=buffer.owners;
+        }
+        for (size_t j=0; j<owners.size(); j++) {
+            if (!owners[j].name)
+                continue;
+            out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+                << owners[j].tid << ",\"args\":{\"name\":\"";
+            writeEscaped(out,owners[j].name);
+            out << "\"}}";
+            first=false;
+        }
+
+        size_t owner=0;
+        for (size_t j=0; j<events.size(); j++, index++) {
+            while ((owner+1<owners.size())&&(owners[owner+1].start<=index))
+                owner++;
+            const Event &event=events[j];
+            out << (first ? "" : ",") << "\n{\"name\":\"";
+            writeEscaped(out,event.name);
+            out << "\",\"cat\":\"mdc2250\",\"pid\":1,\"tid\":" << owners[owner].tid
+                << ",\"ts\":" << event.begin*1.0e6;
+            if (event.duration<0)
+                out << ",\"ph\":\"i\",\"s\":\"t\"";
+            else
+                out << ",\"ph\":\"X\",\"dur\":" << event.duration*1.0e6;
+            out << ",\"args\":{\"arg\":" << event.arg;
+            if (event.label[0]) {
+                out << ",\"label\":\"";
+                writeEscaped(out,event.label);
+                out << "\"";
+            }
+            out << "}}";
+            first=false;
+        }
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool trace::dump(const std::string &path) {
+    std::ofstream file(path.c_str());
+    if (!file)
+        return false;
+    file << toJson();
+    return file.good();
+}
@@ -0,0 +1,223 @@
+#include "mdc2250/mdc2250_trajectory.h"
+#include "mdc2250/mdc2250_clock.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <boost/bind.hpp>
+using namespace mdc2250;
+using namespace trajectorymode;
+
+/***** Inline Functions *****/
+
+// Cubic Hermite interpolation of position, velocity and acceleration
+inline void hermite(const TrajectoryPoint &p0, const TrajectoryPoint &p1, double t,
+                    TrajectoryPoint &result, double &acceleration) {
+    double h=p1.time-p0.time;
+    double s=(t-p0.time)/h;
+    double s2=s*s;
+    double s3=s2*s;
+    double m0=p0.velocity*h;
+    double m1=p1.velocity*h;
+    result.time=t;
+    result.position=(2*s3-3*s2+1)*p0.position+(s3-2*s2+s)*m0
+        +(-2*s3+3*s2)*p1.position+(s3-s2)*m1;
+    result.velocity=((6*s2-6*s)*p0.position+(3*s2-4*s+1)*m0
+        +(-6*s2+6*s)*p1.position+(3*s2-2*s)*m1)/h;
+    acceleration=((12*s-6)*p0.position+(6*s-4)*m0
+        +(-12*s+6)*p1.position+(6*s-2)*m1)/(h*h);
+}
+
+/***** TrajectoryStreamer Class Functions *****/
+
+TrajectoryStreamer::TrajectoryStreamer(SendFunction sendFunction)
+    : send(sendFunction), running(false), startTime(0), timingErrorSum(0) {
+    std::memset(&stats,0,sizeof(stats));
+    for (int ii=0; ii<2; ii++) {
+        channels[ii].active=false;
+        channels[ii].finished=false;
+        channels[ii].lastAcceleration=0;
+        // MDC2250 factory default of 100 PPR, four counts per pulse
+        channels[ii].countsPerRevolution=400.0;
+    }
+}
+
+TrajectoryStreamer::~TrajectoryStreamer() {
+    stop();
+}
+
+void TrajectoryStreamer::start(const TrajectoryOptions &newOptions) {
+    stop();
+    options=newOptions;
+    if (options.periodUs<=0)
+        options.periodUs=10000;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        for (int ii=0; ii<2; ii++) {
+            channels[ii].points.clear();
+            channels[ii].active=false;
+            channels[ii].finished=false;
+            channels[ii].lastAcceleration=0;
+        }
+        std::memset(&stats,0,sizeof(stats));
+        timingErrorSum=0;
+        startTime=monotonicTime();
+    }
+    timer.reset();
+    running=true;
+    thread.reset(new boost::thread(boost::bind(&TrajectoryStreamer::run,this)));
+}
+
+void TrajectoryStreamer::stop() {
+    if (!thread)
+        return;
+    timer.cancel();
+    thread->join();
+    thread.reset();
+    running=false;
+}
+
+bool TrajectoryStreamer::append(int channel, const std::vector<TrajectoryPoint> &points) {
+    if ((channel<1)||(channel>2))
+        return false;
+    if (points.empty())
+        return true;
+    boost::mutex::scoped_lock lock(mutex);
+    Channel &ch=channels[channel-1];
+    double last=ch.points.empty() ? -1.0e300 : ch.points.back().time;
+    for (size_t ii=0; ii<points.size(); ii++) {
+        if (points[ii].time<=last) {
+            std::cout << "Trajectory point times must increase. Points not added." << std::endl;
+            return false;
+        }
+        last=points[ii].time;
+    }
+    ch.points.insert(ch.points.end(),points.begin(),points.end());
+    ch.active=true;
+    ch.finished=false;
+    return true;
+}
+
+void TrajectoryStreamer::finish(int channel) {
+    if ((channel<1)||(channel>2))
+        return;
+    boost::mutex::scoped_lock lock(mutex);
+    channels[channel-1].finished=true;
+}
+
+bool TrajectoryStreamer::isDone() {
+    boost::mutex::scoped_lock lock(mutex);
+    double t=monotonicTime()-startTime+options.lookahead;
+    for (int ii=0; ii<2; ii++) {
+        const Channel &ch=channels[ii];
+        if (!ch.active)
+            continue;
+        if (!ch.finished||(ch.points.size()>1)||(ch.points.back().time>t))
+            return false;
+    }
+    return true;
+}
+
+void TrajectoryStreamer::setEncoderPPR(int channel, int ppr) {
+    if ((channel<1)||(channel>2)||(ppr<1))
+        return;
+    boost::mutex::scoped_lock lock(mutex);
+    channels[channel-1].countsPerRevolution=4.0*ppr;
+}
+
+TrajectoryStats TrajectoryStreamer::getStats() {
+    boost::mutex::scoped_lock lock(mutex);
+    TrajectoryStats result=stats;
+    double elapsed=monotonicTime()-startTime;
+    result.commandRate=(elapsed>0) ? stats.setpoints/elapsed : 0.0;
+    result.meanTimingError=(stats.setpoints>0) ? timingErrorSum/stats.setpoints : 0.0;
+    result.buffered=channels[0].points.size()+channels[1].points.size();
+    return result;
+}
+
+// must be called with mutex held, returns false if the profile ran out
+bool TrajectoryStreamer::sample(Channel &ch, double t, TrajectoryPoint &result, double &acceleration) {
+    // drop the segments that are completely in the past
+    while ((ch.points.size()>1)&&(ch.points[1].time<=t))
+        ch.points.pop_front();
+
+    acceleration=0;
+    if (t<=ch.points.front().time) {
+        result=ch.points.front();
+        return true;
+    }
+    if (ch.points.size()==1) {
+        // hold the end of the profile
+        result=ch.points.front();
+        result.velocity=0;
+        return ch.finished;
+    }
+    hermite(ch.points[0],ch.points[1],t,result,acceleration);
+    return true;
+}
+
+void TrajectoryStreamer::run() {
+    applyRealtimeOptions(options.realtime);
+
+    double period=options.periodUs/1.0e6;
+    double deadline=monotonicTime()+period;
+    while (timer.waitUntil(deadline)) {
+        std::stringstream cmd;
+        int commands=0;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            double t=deadline-startTime+options.lookahead;
+            for (int ii=0; ii<2; ii++) {
+                Channel &ch=channels[ii];
+                if (!ch.active||ch.points.empty())
+                    continue;
+                TrajectoryPoint point;
+                double acceleration;
+                if (!sample(ch,t,point,acceleration))
+                    stats.underruns++;
+
+                if (commands>0)
+                    cmd << "_";
+                if (options.mode==_POSITION) {
+                    cmd << "!P " << ii+1 << " " << (long)std::floor(point.position+0.5);
+                } else {
+                    double rpmPerCount=60.0/ch.countsPerRevolution;
+                    if (options.sendAcceleration&&(acceleration!=0)) {
+                        // !AC and !DC take 0.1 RPM/s
+                        long value=(long)std::floor(std::fabs(acceleration)*rpmPerCount*10.0+0.5);
+                        bool speedingUp=(acceleration>0)==(point.velocity>0);
+                        long signedValue=speedingUp ? value : -value;
+                        if ((value>0)&&(signedValue!=ch.lastAcceleration)) {
+                            cmd << (speedingUp ? "!AC " : "!DC ") << ii+1 << " " << value << "_";
+                            ch.lastAcceleration=signedValue;
+                        }
+                    }
+                    cmd << "!S " << ii+1 << " " << (long)std::floor(point.velocity*rpmPerCount+0.5);
+                }
+                commands++;
+            }
+        }
+
+        if (commands>0) {
+            cmd << "\r";
+            send(cmd.str());
+        }
+
+        // schedule the next tick, skipping any that were already missed
+        double now=monotonicTime();
+        boost::mutex::scoped_lock lock(mutex);
+        stats.ticks++;
+        if (commands>0) {
+            double error=now-deadline;
+            stats.setpoints+=commands;
+            timingErrorSum+=error*commands;
+            if (error>stats.maxTimingError)
+                stats.maxTimingError=error;
+        }
+        deadline+=period;
+        while (deadline<=now) {
+            deadline+=period;
+            stats.overruns++;
+        }
+    }
+}
@@ -0,0 +1,370 @@
+#include "mdc2250/mdc2250_transport.h"
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <boost/bind.hpp>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+using namespace mdc2250;
+
+/***** SerialTransport Class Functions *****/
+
+SerialTransport::SerialTransport() : baudrate(115200), reading(false) {
+}
+
+SerialTransport::~SerialTransport() {
+    stopContinuousRead();
+}
+
+void SerialTransport::open(const std::string &name) {
+    port.setPort(name);
+    port.setBaudrate(baudrate);
+    port.open();
+}
+
+void SerialTransport::close() {
+    stopContinuousRead();
+    port.close();
+}
+
+bool SerialTransport::isOpen() {
+    return port.isOpen();
+}
+
+void SerialTransport::setBaudrate(unsigned long newBaudrate) {
+    baudrate=newBaudrate;
+}
+
+unsigned long SerialTransport::getBaudrate() {
+    return baudrate;
+}
+
+void SerialTransport::setTimeoutMilliseconds(long ms) {
+    port.setTimeoutMilliseconds(ms);
+}
+
+std::string SerialTransport::read(size_t size) {
+    return port.read(size);
+}
+
+size_t SerialTransport::write(const std::string &data) {
+    return port.write(data);
+}
+
+void SerialTransport::setReadCallback(ReadCallback newCallback) {
+    callback=newCallback;
+}
+
+void SerialTransport::setReadErrorCallback(ReadErrorCallback callback) {
+    errorCallback=callback;
+}
+
+void SerialTransport::startContinuousRead() {
+    stopContinuousRead();
+    reading=true;
+    thread.reset(new boost::thread(boost::bind(&SerialTransport::readLoop,this)));
+}
+
+void SerialTransport::stopContinuousRead() {
+    if (!thread)
+        return;
+    reading=false;
+    // the read error callback may stop reading from the read thread itself
+    if (boost::this_thread::get_id()!=thread->get_id())
+        thread->join();
+    else
+        thread->detach();
+    thread.reset();
+}
+
+void SerialTransport::readLoop() {
+    while (reading) {
+        std::string data;
+        try {
+            // returns early with what arrived when the port timeout expires
+            data=port.read(50);
+        } catch (std::exception &e) {
+            reading=false;
+            if (errorCallback)
+                errorCallback(e.what());
+            return;
+        }
+        if (!data.empty()&&callback)
+            callback(data.data(),data.length());
+    }
+}
+
+/***** BufferedTransport Class Functions *****/
+
+BufferedTransport::BufferedTransport() : continuous(false), timeoutMs(50) {
+}
+
+void BufferedTransport::setTimeoutMilliseconds(long ms) {
+    boost::mutex::scoped_lock lock(mutex);
+    timeoutMs=ms;
+}
+
+std::string BufferedTransport::read(size_t size) {
+    boost::mutex::scoped_lock lock(mutex);
+    boost::system_time deadline=boost::get_system_time()+boost::posix_time::milliseconds(timeoutMs);
+    while (buffer.length()<size) {
+        if (!dataAvailable.timed_wait(lock,deadline))
+            break;
+    }
+    std::string result=buffer.substr(0,size);
+    buffer.erase(0,result.length());
+    return result;
+}
+
+void BufferedTransport::setReadCallback(ReadCallback newCallback) {
+    boost::mutex::scoped_lock lock(mutex);
+    callback=newCallback;
+}
+
+void BufferedTransport::startContinuousRead() {
+    std::string pending;
+    ReadCallback handler;
+    // ahead of anything received meanwhile
+    boost::mutex::scoped_lock deliverLock(deliverMutex);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        continuous=true;
+        pending.swap(buffer);
+        handler=callback;
+    }
+    // hand over anything that arrived before continuous reading started
+    if (!pending.empty()&&handler)
+        handler(pending.data(),pending.length());
+}
+
+void BufferedTransport::stopContinuousRead() {
+    boost::mutex::scoped_lock lock(mutex);
+    continuous=false;
+}
+
+void BufferedTransport::setReadErrorCallback(ReadErrorCallback newCallback) {
+    boost::mutex::scoped_lock lock(mutex);
+    errorCallback=newCallback;
+}
+
+void BufferedTransport::readFailed(const std::string &reason) {
+    ReadErrorCallback handler;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!continuous)
+            return;
+        handler=errorCallback;
+    }
+    if (handler)
+        handler(reason);
+}
+
+void BufferedTransport::receive(const char *data, size_t length) {
+    ReadCallback handler;
+    boost::mutex::scoped_lock deliverLock(deliverMutex);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!continuous||!callback) {
+            buffer.append(data,length);
+            dataAvailable.notify_all();
+            return;
+        }
+        handler=callback;
+    }
+    // called without the buffer lock so the handler may stop reading
+    handler(data,length);
+}
+
+void BufferedTransport::clearBuffer() {
+    boost::mutex::scoped_lock lock(mutex);
+    buffer.clear();
+}
+
+#if !defined(_WIN32)
+
+/***** PtyTransport Class Functions *****/
+
+PtyTransport::PtyTransport() : master(-1), reading(false) {
+}
+
+PtyTransport::~PtyTransport() {
+    close();
+}
+
+void PtyTransport::open(const std::string &port) {
+    close();
+    master=posix_openpt(O_RDWR|O_NOCTTY);
+    if ((master<0)||(grantpt(master)!=0)||(unlockpt(master)!=0)) {
+        std::string error=std::strerror(errno);
+        if (master>=0)
+            ::close(master);
+        master=-1;
+        throw std::runtime_error("Failed to create pseudo terminal: "+error);
+    }
+    slave=ptsname(master);
+
+    // raw mode so carriage returns pass through untouched
+    struct termios settings;
+    if (tcgetattr(master,&settings)==0) {
+        cfmakeraw(&settings);
+        tcsetattr(master,TCSANOW,&settings);
+    }
+
+    clearBuffer();
+    reading=true;
+    thread.reset(new boost::thread(boost::bind(&PtyTransport::readLoop,this)));
+}
+
+void PtyTransport::close() {
+    if (thread) {
+        reading=false;
+        thread->join();
+        thread.reset();
+    }
+    if (master>=0)
+        ::close(master);
+    master=-1;
+    slave.clear();
+}
+
+bool PtyTransport::isOpen() {
+    return master>=0;
+}
+
+size_t PtyTransport::write(const std::string &data) {
+    if (master<0)
+        throw std::runtime_error("Pseudo terminal is not open.");
+    size_t written=0;
+    while (written<data.length()) {
+        ssize_t n=::write(master,data.data()+written,data.length()-written);
+        if (n<0) {
+            if (errno==EINTR)
+                continue;
+            throw std::runtime_error(std::string("Failed to write to pseudo terminal: ")+std::strerror(errno));
+        }
+        written+=n;
+    }
+    return written;
+}
+
+void PtyTransport::readLoop() {
+    char data[4096];
+    struct pollfd fd;
+    fd.fd=master;
+    fd.events=POLLIN;
+    while (reading) {
+        int result=poll(&fd,1,50);
+        if ((result<0)&&(errno!=EINTR)) {
+            readFailed(std::string("Failed to poll pseudo terminal: ")+std::strerror(errno));
+            return;
+        }
+        if (result<=0)
+            continue;
+        ssize_t n=::read(master,data,sizeof(data));
+        if (n>0) {
+            receive(data,n);
+        } else if ((n<0)&&(errno!=EIO)&&(errno!=EINTR)&&(errno!=EAGAIN)) {
+            readFailed(std::string("Failed to read from pseudo terminal: ")+std::strerror(errno));
+            return;
+        } else {
+            // EIO until a simulator opens the slave side
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        }
+    }
+}
+
+#endif
+
+/***** LoopbackTransport Class Functions *****/
+
+LoopbackTransport::LoopbackTransport() : peer(NULL), opened(false), delivering(false) {
+}
+
+LoopbackTransport::~LoopbackTransport() {
+    close();
+    if (peer!=NULL)
+        peer->peer=NULL;
+}
+
+void LoopbackTransport::connect(LoopbackTransport &a, LoopbackTransport &b) {
+    a.peer=&b;
+    b.peer=&a;
+}
+
+void LoopbackTransport::open(const std::string &port) {
+    close();
+    clearBuffer();
+    {
+        boost::mutex::scoped_lock lock(inboxMutex);
+        inbox.clear();
+        delivering=true;
+    }
+    opened=true;
+    thread.reset(new boost::thread(boost::bind(&LoopbackTransport::deliverLoop,this)));
+}
+
+void LoopbackTransport::close() {
+    stopContinuousRead();
+    opened=false;
+    if (!thread)
+        return;
+    {
+        boost::mutex::scoped_lock lock(inboxMutex);
+        delivering=false;
+    }
+    inboxReady.notify_all();
+    // the read callback may close the transport from the delivery thread
+    if (boost::this_thread::get_id()!=thread->get_id())
+        thread->join();
+    else
+        thread->detach();
+    thread.reset();
+}
+
+bool LoopbackTransport::isOpen() {
+    return opened;
+}
+
+size_t LoopbackTransport::write(const std::string &data) {
+    if (!opened)
+        throw std::runtime_error("Loopback transport is not open.");
+    if (peer!=NULL)
+        peer->post(data.data(),data.length());
+    return data.length();
+}
+
+void LoopbackTransport::inject(const std::string &data) {
+    post(data.data(),data.length());
+}
+
+void LoopbackTransport::post(const char *data, size_t length) {
+    {
+        boost::mutex::scoped_lock lock(inboxMutex);
+        inbox.append(data,length);
+    }
+    inboxReady.notify_all();
+}
+
+void LoopbackTransport::deliverLoop() {
+    // swapped with the inbox, so the two buffers keep their capacity
+    std::string data;
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(inboxMutex);
+            while (inbox.empty()&&delivering)
+                inboxReady.wait(lock);
+            if (!delivering)
+                return;
+            data.swap(inbox);
+        }
+        receive(data.data(),data.length());
+        data.clear();
+    }
+}
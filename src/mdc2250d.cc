@@ -0,0 +1,449 @@
+/*
+ * mdc2250d - owns the serial port of one MDC2250 and multiplexes it to
+ * local clients over a Unix domain socket.
+ *
+ * Usage: mdc2250d [--allow-maintenance] <serial port> [socket path]
+ *                [telemetry queries] [period ms]
+ *
+ * Clients speak the protocol in mdc2250/mdc2250d_protocol.h.  The socket
+ * is created with mode 0660 in a directory owned by the daemon's user and
+ * writable by no one else, so only that user and its group can connect.
+ * Maintenance commands (%RESET, %EERST, %EESAV, ...) from clients are
+ * refused unless --allow-maintenance is given.  Each telemetry update is
+ * encoded once and that copy is appended for every subscribed client, with
+ * only the client's drop count patched in.  Each client has a bounded
+ * output buffer; when a client does not keep up its updates are dropped and
+ * counted instead of delaying the others.  Updates dropped before fan out,
+ * when the event loop falls behind the read thread, are counted for every
+ * client subscribed to them.  Commands from all clients go through the MDC2250 command
+ * scheduler, which is the only writer to the port.
+ */
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "mdc2250/mdc2250.h"
+#include "mdc2250/mdc2250_clock.h"
+#include "mdc2250/mdc2250d_protocol.h"
+using namespace mdc2250;
+
+static const size_t MAX_PENDING_SAMPLES = 4096; //!< read thread to event loop queue
+static const size_t MAX_CLIENT_BUFFER = 64*1024; //!< output bytes buffered per client
+static const size_t MAX_CLIENTS = 256;
+
+/***** Shared State *****/
+
+static volatile sig_atomic_t stopRequested=0;
+static bool allowMaintenance=false; //!< pass % commands from clients to the controller
+
+static boost::mutex pendingMutex;
+static std::deque<TelemetrySample> pendingSamples;
+static unsigned long pendingDropped=0;
+static boost::uint32_t pendingDroppedByQuery[32]; //!< dropped before fan out, by query bit
+static boost::uint64_t sampleSequence=0;
+static int wakePipe[2];
+
+struct Client {
+    int fd;
+    boost::uint32_t queryMask;
+    std::string input;
+    std::string output;
+    size_t outputOffset; //!< bytes of output already sent
+    boost::uint32_t dropped; //!< updates dropped since the last one delivered
+    unsigned long sent;
+    unsigned long refused; //!< maintenance commands refused
+    unsigned long totalDropped;
+    size_t maxBuffered;
+};
+
+/***** Helpers *****/
+
+void handleSignal(int) {
+    stopRequested=1;
+}
+
+bool setNonBlocking(int fd) {
+    int flags=fcntl(fd,F_GETFL,0);
+    return (flags>=0)&&(fcntl(fd,F_SETFL,flags|O_NONBLOCK)==0);
+}
+
+// Returns the class a client command is queued in: derived from the
+// command, a client may only ask for a lower one, and the safety lane is
+// kept for a lone emergency stop or release, which is never lowered
+commandpriority::CommandPriority clientPriority(const std::string &cmd, int requested) {
+    using namespace commandpriority;
+    int priority=classifyCommand(cmd);
+    if (priority==_SAFETY) {
+        size_t start=cmd.find_first_not_of("\r");
+        size_t end=cmd.find_last_not_of("\r");
+        if ((start==std::string::npos)||(end-start+1!=3))
+            priority=_MOTION;
+    }
+    if ((priority!=_SAFETY)&&(requested<COUNT)&&(requested>priority))
+        priority=requested;
+    return (CommandPriority)priority;
+}
+
+void appendMessage(std::string &buffer, int type, const void *body, size_t length) {
+    MessageHeader header;
+    header.length=(boost::uint16_t)length;
+    header.type=(boost::uint8_t)type;
+    header.reserved=0;
+    buffer.append((const char*)&header,sizeof(header));
+    buffer.append((const char*)body,length);
+}
+
+// Called on the serial read thread - keep it short
+void queueTelemetry(const mdc2250_raw_status &status, RuntimeQuery::runtimeQuery query) {
+    TelemetrySample sample;
+    sample.time=monotonicTime();
+    sample.query=query;
+    sample.status=status;
+    bool wasEmpty;
+    {
+        boost::mutex::scoped_lock lock(pendingMutex);
+        sample.sequence=sampleSequence++;
+        if (pendingSamples.size()>=MAX_PENDING_SAMPLES) {
+            int dropped=pendingSamples.front().query;
+            if ((dropped>=0)&&(dropped<32))
+                pendingDroppedByQuery[dropped]++;
+            pendingSamples.pop_front();
+            pendingDropped++;
+        }
+        wasEmpty=pendingSamples.empty();
+        pendingSamples.push_back(sample);
+    }
+    // only wake the event loop once per batch
+    if (wasEmpty) {
+        char byte=0;
+        ssize_t n=write(wakePipe[1],&byte,1);
+        (void)n;
+    }
+}
+
+// Creates the directory of the socket if needed and checks that it belongs
+// to the daemon's user and is not writable by anyone else, so no other user
+// can replace the socket or reach it through a directory of their own
+bool prepareSocketDirectory(const std::string &path) {
+    size_t slash=path.rfind('/');
+    std::string directory=(slash==std::string::npos) ? "." : path.substr(0,(slash==0) ? 1 : slash);
+    if ((mkdir(directory.c_str(),0750)!=0)&&(errno!=EEXIST)) {
+        std::cerr << "mdc2250d: Failed to create " << directory << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (lstat(directory.c_str(),&info)!=0) {
+        std::cerr << "mdc2250d: Failed to check " << directory << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (!S_ISDIR(info.st_mode)||(info.st_uid!=geteuid())||((info.st_mode&(S_IWGRP|S_IWOTH))!=0)) {
+        std::cerr << "mdc2250d: " << directory << " must be a directory owned by this user and "
+                  << "writable by no one else, e.g. /run/mdc2250d." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int openListener(const std::string &path) {
+    if (!prepareSocketDirectory(path))
+        return -1;
+    int fd=socket(AF_UNIX,SOCK_STREAM,0);
+    if (fd<0)
+        return -1;
+    struct sockaddr_un address;
+    std::memset(&address,0,sizeof(address));
+    address.sun_family=AF_UNIX;
+    std::strncpy(address.sun_path,path.c_str(),sizeof(address.sun_path)-1);
+    unlink(path.c_str());
+    // user and group only, from the moment the socket exists
+    mode_t mask=umask(0117);
+    int bound=bind(fd,(struct sockaddr*)&address,sizeof(address));
+    umask(mask);
+    if ((bound!=0)||(chmod(path.c_str(),0660)!=0)||(listen(fd,16)!=0)||!setNonBlocking(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void closeClient(Client &client) {
+    std::cout << "mdc2250d: Client " << client.fd << " disconnected. Sent: " << client.sent
+              << " Dropped: " << client.totalDropped << " Max buffered: " << client.maxBuffered
+              << " bytes Refused: " << client.refused << std::endl;
+    close(client.fd);
+    client.fd=-1;
+}
+
+// Parses complete messages from the client's input buffer
+void handleInput(Client &client, MDC2250 &controller) {
+    size_t offset=0;
+    while (client.input.length()-offset>=sizeof(MessageHeader)) {
+        MessageHeader header;
+        std::memcpy(&header,client.input.data()+offset,sizeof(header));
+        if (client.input.length()-offset<sizeof(header)+header.length)
+            break;
+        const char *body=client.input.data()+offset+sizeof(header);
+
+        if ((header.type==daemonmessage::_SUBSCRIBE)&&(header.length>=sizeof(SubscribeMessage))) {
+            SubscribeMessage message;
+            std::memcpy(&message,body,sizeof(message));
+            client.queryMask=message.queryMask;
+        } else if ((header.type==daemonmessage::_COMMAND)&&(header.length>sizeof(CommandMessage))) {
+            CommandMessage message;
+            std::memcpy(&message,body,sizeof(message));
+            std::string cmd(body+sizeof(message),header.length-sizeof(message));
+            if (cmd[cmd.length()-1]!='\r')
+                cmd+="\r";
+            // % only starts maintenance commands, wherever it is in the frame
+            if (!allowMaintenance&&(cmd.find('%')!=std::string::npos)) {
+                if (client.refused++==0)
+                    std::cout << "mdc2250d: Refused maintenance command from client " << client.fd
+                              << ", start with --allow-maintenance to pass them." << std::endl;
+            } else {
+                controller.sendCommand(cmd,clientPriority(cmd,message.priority));
+            }
+        }
+        offset+=sizeof(header)+header.length;
+    }
+    client.input.erase(0,offset);
+}
+
+// Sends as much buffered output as the socket takes without blocking
+bool flushOutput(Client &client) {
+    while (client.outputOffset<client.output.length()) {
+        ssize_t n=send(client.fd,client.output.data()+client.outputOffset,
+                       client.output.length()-client.outputOffset,MSG_NOSIGNAL);
+        if (n<0) {
+            if ((errno==EAGAIN)||(errno==EWOULDBLOCK))
+                break;
+            return false;
+        }
+        client.outputOffset+=n;
+    }
+    if (client.outputOffset==client.output.length()) {
+        client.output.clear();
+        client.outputOffset=0;
+    } else if (client.outputOffset>client.output.length()/2) {
+        client.output.erase(0,client.outputOffset);
+        client.outputOffset=0;
+    }
+    return true;
+}
+
+// Appends each pending update to the subscribed clients, after counting
+// the updates dropped before fan out for the clients that wanted them
+void fanOut(std::vector<Client> &clients, const std::vector<TelemetrySample> &samples,
+            const boost::uint32_t *droppedByQuery) {
+    for (size_t jj=0; jj<clients.size(); jj++) {
+        Client &client=clients[jj];
+        for (int query=0; query<32; query++) {
+            if ((client.fd>=0)&&(client.queryMask&(1u<<query))) {
+                client.dropped+=droppedByQuery[query];
+                client.totalDropped+=droppedByQuery[query];
+            }
+        }
+    }
+
+    // where the drop count sits in an encoded message
+    static const size_t droppedOffset=sizeof(MessageHeader)+offsetof(TelemetryMessage,dropped);
+    std::string encoded;
+    TelemetryMessage message;
+    message.dropped=0;
+    for (size_t ii=0; ii<samples.size(); ii++) {
+        message.sample=samples[ii];
+        encoded.clear();
+        appendMessage(encoded,daemonmessage::_TELEMETRY,&message,sizeof(message));
+        boost::uint32_t bit=queryBit((RuntimeQuery::runtimeQuery)samples[ii].query);
+        for (size_t jj=0; jj<clients.size(); jj++) {
+            Client &client=clients[jj];
+            if ((client.fd<0)||((client.queryMask&bit)==0))
+                continue;
+            size_t buffered=client.output.length()-client.outputOffset;
+            if (buffered+encoded.length()>MAX_CLIENT_BUFFER) {
+                // slow client - drop rather than delay everyone
+                client.dropped++;
+                client.totalDropped++;
+                continue;
+            }
+            size_t start=client.output.length();
+            client.output.append(encoded);
+            std::memcpy(&client.output[start+droppedOffset],&client.dropped,sizeof(client.dropped));
+            client.dropped=0;
+            client.sent++;
+            if (buffered+encoded.length()>client.maxBuffered)
+                client.maxBuffered=buffered+encoded.length();
+        }
+    }
+}
+
+/***** Main *****/
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args;
+    for (int ii=1; ii<argc; ii++) {
+        if (std::strcmp(argv[ii],"--allow-maintenance")==0)
+            allowMaintenance=true;
+        else
+            args.push_back(argv[ii]);
+    }
+    if (args.empty()) {
+        std::cerr << "Usage: mdc2250d [--allow-maintenance] <serial port> [socket path] "
+                  << "[telemetry queries] [period ms]" << std::endl;
+        return 0;
+    }
+    std::string port(args[0]);
+    std::string socketPath=(args.size()>1) ? args[1] : DAEMON_SOCKET_PATH;
+
+    struct sigaction action;
+    std::memset(&action,0,sizeof(action));
+    action.sa_handler=handleSignal;
+    sigaction(SIGINT,&action,NULL);
+    sigaction(SIGTERM,&action,NULL);
+    signal(SIGPIPE,SIG_IGN);
+
+    if ((pipe(wakePipe)!=0)||!setNonBlocking(wakePipe[0])||!setNonBlocking(wakePipe[1])) {
+        std::cerr << "mdc2250d: Failed to create wake pipe." << std::endl;
+        return -1;
+    }
+
+    MDC2250 controller;
+    if (!controller.connect(port)) {
+        std::cerr << "mdc2250d: Failed to connect to " << port << std::endl;
+        return -1;
+    }
+    controller.setRawQueryCallback(queueTelemetry);
+    if (args.size()>3)
+        controller.setTelemetryString(args[2],std::atol(args[3].c_str()));
+    controller.startContinuousReading();
+
+    int listener=openListener(socketPath);
+    if (listener<0) {
+        std::cerr << "mdc2250d: Failed to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    std::cout << "mdc2250d: Serving " << port << " on " << socketPath << std::endl;
+
+    std::vector<Client> clients;
+    std::vector<struct pollfd> fds;
+    std::vector<TelemetrySample> samples;
+    HelloMessage hello;
+    hello.version=DAEMON_PROTOCOL_VERSION;
+    hello.sampleSize=sizeof(TelemetrySample);
+
+    while (!stopRequested) {
+        fds.clear();
+        struct pollfd entry;
+        entry.fd=listener;
+        entry.events=POLLIN;
+        fds.push_back(entry);
+        entry.fd=wakePipe[0];
+        fds.push_back(entry);
+        for (size_t ii=0; ii<clients.size(); ii++) {
+            entry.fd=clients[ii].fd;
+            entry.events=POLLIN;
+            if (clients[ii].outputOffset<clients[ii].output.length())
+                entry.events|=POLLOUT;
+            fds.push_back(entry);
+        }
+
+        if (poll(&fds[0],fds.size(),-1)<0) {
+            if (errno==EINTR)
+                continue;
+            std::cerr << "mdc2250d: poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        // telemetry from the read thread
+        if (fds[1].revents&POLLIN) {
+            char drain[64];
+            while (read(wakePipe[0],drain,sizeof(drain))>0) {}
+            samples.clear();
+            boost::uint32_t dropped[32];
+            {
+                boost::mutex::scoped_lock lock(pendingMutex);
+                samples.assign(pendingSamples.begin(),pendingSamples.end());
+                pendingSamples.clear();
+                std::memcpy(dropped,pendingDroppedByQuery,sizeof(dropped));
+                std::memset(pendingDroppedByQuery,0,sizeof(pendingDroppedByQuery));
+            }
+            fanOut(clients,samples,dropped);
+        }
+
+        // existing clients
+        for (size_t ii=0; ii<clients.size(); ii++) {
+            Client &client=clients[ii];
+            short revents=fds[ii+2].revents;
+            if (revents&(POLLIN|POLLHUP|POLLERR)) {
+                char buffer[4096];
+                ssize_t n=recv(client.fd,buffer,sizeof(buffer),0);
+                if (n>0) {
+                    client.input.append(buffer,n);
+                    handleInput(client,controller);
+                } else if ((n==0)||((errno!=EAGAIN)&&(errno!=EWOULDBLOCK))) {
+                    closeClient(client);
+                    continue;
+                }
+            }
+            if ((client.outputOffset<client.output.length())&&!flushOutput(client))
+                closeClient(client);
+        }
+
+        // new clients
+        if (fds[0].revents&POLLIN) {
+            int fd;
+            while ((fd=accept(listener,NULL,NULL))>=0) {
+                if ((clients.size()>=MAX_CLIENTS)||!setNonBlocking(fd)) {
+                    close(fd);
+                    continue;
+                }
+                Client client;
+                client.fd=fd;
+                client.queryMask=0;
+                client.outputOffset=0;
+                client.dropped=0;
+                client.sent=0;
+                client.refused=0;
+                client.totalDropped=0;
+                client.maxBuffered=0;
+                appendMessage(client.output,daemonmessage::_HELLO,&hello,sizeof(hello));
+                flushOutput(client);
+                clients.push_back(client);
+                std::cout << "mdc2250d: Client " << fd << " connected." << std::endl;
+            }
+        }
+
+        // forget closed clients
+        size_t kept=0;
+        for (size_t ii=0; ii<clients.size(); ii++)
+            if (clients[ii].fd>=0)
+                clients[kept++]=clients[ii];
+        clients.resize(kept);
+    }
+
+    std::cout << "mdc2250d: Shutting down." << std::endl;
+    for (size_t ii=0; ii<clients.size(); ii++)
+        closeClient(clients[ii]);
+    close(listener);
+    unlink(socketPath.c_str());
+    controller.stopContinuousReading();
+    controller.disconnect();
+    {
+        boost::mutex::scoped_lock lock(pendingMutex);
+        if (pendingDropped>0)
+            std::cout << "mdc2250d: " << pendingDropped << " updates dropped before fan out." << std::endl;
+    }
+    return 0;
+}
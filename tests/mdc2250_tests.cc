@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "mdc2250/mdc2250.h"
+#include "mdc2250/mdc2250_columns.h"
+using namespace mdc2250;
+
+namespace {
+
+/*!
+ * Controller simulator on the far end of a loopback transport.
+ *
+ * Like the controller it answers from its read callback: the handshake,
+ * an acknowledgement for every command and, once armed, a fault flag
+ * report right after the first motor command.
+ */
+class ControllerSimulator {
+public:
+    LoopbackTransport port;
+
+    ControllerSimulator() : faults(0) {
+        port.setReadCallback(boost::bind(&ControllerSimulator::onData,this,_1,_2));
+        port.open("simulator");
+        port.startContinuousRead();
+    }
+
+    ~ControllerSimulator() {
+        port.close();
+    }
+
+    //! Reports the fault flags after the first motor command
+    void setFaults(int flags) {
+        boost::mutex::scoped_lock lock(mutex);
+        faults=flags;
+    }
+
+    //! Waits until a frame was received, false after timeout [s]
+    bool waitFor(const std::string &frame, double timeout) {
+        boost::system_time deadline=boost::get_system_time()
+            +boost::posix_time::microseconds((long)(timeout*1.0e6));
+        boost::mutex::scoped_lock lock(mutex);
+        while (std::find(frames.begin(),frames.end(),frame)==frames.end())
+            if (!received.timed_wait(lock,deadline))
+                return false;
+        return true;
+    }
+
+private:
+    void onData(const char *data, size_t length) {
+        carry.append(data,length);
+        size_t end;
+        while ((end=carry.find('\r'))!=std::string::npos) {
+            std::string frame=carry.substr(0,end);
+            carry.erase(0,end+1);
+            if (!frame.empty())
+                answer(frame);
+        }
+    }
+
+    void answer(const std::string &frame) {
+        std::string reply;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            frames.push_back(frame);
+            if (frame=="?TRN")
+                reply="TRN=RCB500:MDC2250\r";
+            else if (frame=="?FID")
+                reply="FID=Roboteq v1.0 MDC2250 01/01/2011\r";
+            else if (frame[0]=='!')
+                reply="+\r";
+            if ((frame.compare(0,2,"!M")==0)&&(faults!=0)) {
+                std::ostringstream report;
+                report << "FF=" << faults << "\r";
+                reply+=report.str();
+                faults=0;
+            }
+        }
+        received.notify_all();
+        if (!reply.empty())
+            port.write(reply);
+    }
+
+    std::string carry;
+    boost::mutex mutex;
+    boost::condition_variable received;
+    std::vector<std::string> frames;
+    int faults;
+};
+
+}
+
+TEST(LoopbackTransport, FaultRuleFiresOnReplyToMotorCommand) {
+    ControllerSimulator simulator;
+    boost::shared_ptr<LoopbackTransport> link(new LoopbackTransport());
+    LoopbackTransport::connect(*link,simulator.port);
+    MDC2250 mdc2250(link);
+    ASSERT_TRUE(mdc2250.connect("loopback"));
+
+    // the fault arrives in the reply to a command written by the scheduler
+    mdc2250.addFaultRule(FaultRule(faultflag::_SHORTCIRCUIT,faultaction::_ZERO_MOTORS));
+    mdc2250.startContinuousReading();
+    simulator.setFaults(faultflag::_SHORTCIRCUIT);
+    EXPECT_TRUE(mdc2250.multiMotorCmd(100,100));
+    EXPECT_TRUE(simulator.waitFor("!M 0 0",1.0));
+    EXPECT_EQ(1ul,mdc2250.getReflexStats().fired);
+    mdc2250.disconnect();
+}
+
+TEST(ConnectionSupervisor, SilenceIsOnlyALossWithTelemetry) {
+    ControllerSimulator simulator;
+    boost::shared_ptr<LoopbackTransport> link(new LoopbackTransport());
+    LoopbackTransport::connect(*link,simulator.port);
+    MDC2250 mdc2250(link);
+    ASSERT_TRUE(mdc2250.connect("loopback"));
+    mdc2250.startContinuousReading();
+    mdc2250.enableSupervisor();
+
+    // acknowledgements arrive, then nothing for many default timeouts
+    EXPECT_TRUE(mdc2250.multiMotorCmd(0,0));
+    EXPECT_TRUE(simulator.waitFor("!M 0 0",1.0));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(600));
+    EXPECT_EQ(0ul,mdc2250.getSupervisorStats().losses);
+
+    // the simulator never sends the telemetry it is asked for
+    mdc2250.setTelemetryString("?FF",50);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+    EXPECT_LE(1ul,mdc2250.getSupervisorStats().losses);
+    mdc2250.disconnect();
+}
+
+namespace {
+
+// Records writes, holding the first one until released
+class BlockingPort {
+public:
+    BlockingPort() : held(true), blocked(false) {}
+
+    bool write(const std::string &data) {
+        boost::mutex::scoped_lock lock(mutex);
+        written.push_back(data);
+        blocked=true;
+        changed.notify_all();
+        while (held)
+            changed.wait(lock);
+        return true;
+    }
+
+    void waitUntilBlocked() {
+        boost::mutex::scoped_lock lock(mutex);
+        while (!blocked)
+            changed.wait(lock);
+    }
+
+    void release() {
+        boost::mutex::scoped_lock lock(mutex);
+        held=false;
+        changed.notify_all();
+    }
+
+    boost::mutex mutex;
+    boost::condition_variable changed;
+    std::vector<std::string> written;
+    bool held, blocked;
+};
+
+}
+
+TEST(CommandScheduler, StopPurgesQueuedMotion) {
+    BlockingPort port;
+    CommandScheduler scheduler(boost::bind(&BlockingPort::write,&port,_1));
+    SchedulerOptions options;
+    options.maxBatch=1;
+    scheduler.start(options);
+
+    // the first command holds the port while the others queue behind it
+    scheduler.send("?A\r",commandpriority::_QUERY);
+    port.waitUntilBlocked();
+    scheduler.send("!G 1 500\r",commandpriority::_MOTION);
+    scheduler.send("?V\r",commandpriority::_QUERY);
+    scheduler.send("!M 500 500\r",commandpriority::_MOTION);
+    boost::thread stop(boost::bind(&CommandScheduler::send,&scheduler,"!M 0 0\r",
+                                   commandpriority::_SAFETY,true));
+    while (scheduler.getStats().purged<2)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    port.release();
+    stop.join();
+    scheduler.stop();
+
+    ASSERT_EQ(3u,port.written.size());
+    EXPECT_EQ("?A\r",port.written[0]);
+    EXPECT_EQ("!M 0 0\r",port.written[1]);
+    EXPECT_EQ("?V\r",port.written[2]);
+}
+
+TEST(ClockSync, BecomesValidAtLowTelemetryRates) {
+    // ?TM every 250 ms, arriving 2 ms after the controller time
+    ClockSync sync;
+    sync.setTelemetryPeriod(0.25);
+    for (int i=0; i<40; i++) {
+        double controller=100.0+i*0.25;
+        sync.update((long)controller,controller+0.002);
+    }
+    ASSERT_TRUE(sync.isValid());
+    EXPECT_NEAR(0.002,sync.getState().offset,0.25);
+}
+
+namespace {
+
+// Loopback whose driver rejects every rate above 115200
+class RateLimitedLoopback : public LoopbackTransport {
+public:
+    RateLimitedLoopback() : rate(0) {}
+    void setBaudrate(unsigned long baudrate) { rate=baudrate; }
+    unsigned long getBaudrate() { return rate; }
+    void open(const std::string &port) {
+        if (rate>115200)
+            throw std::invalid_argument("unsupported baud rate");
+        LoopbackTransport::open(port);
+    }
+
+    unsigned long rate;
+};
+
+}
+
+TEST(MDC2250, ConnectSkipsRejectedRates) {
+    ControllerSimulator simulator;
+    boost::shared_ptr<RateLimitedLoopback> link(new RateLimitedLoopback());
+    LoopbackTransport::connect(*link,simulator.port);
+    MDC2250 mdc2250(link);
+    LinkOptions options;
+    options.baudrates.push_back(460800);
+    ASSERT_TRUE(mdc2250.connect("loopback",options));
+    EXPECT_EQ(115200ul,mdc2250.getLinkInfo().baudrate);
+    mdc2250.disconnect();
+}
+
+TEST(OdometryEstimator, CountsEveryFrameOfARead) {
+    OdometryEstimator odometry;
+    odometry.setEncoderPPR(1,256);
+    odometry.setEncoderPPR(2,256);
+    odometry.updateAbsolute(0,0,1.0);
+
+    // a 100 ms read holding a backlog of four 100 count frames
+    for (int i=1; i<=4; i++)
+        odometry.updateAbsolute(i*100,i*100,1.1);
+    double expected=2.0*M_PI*400/1024/0.1;
+    EXPECT_NEAR(expected,odometry.getState().wheelVelocity[0],1e-9);
+    EXPECT_NEAR(expected,odometry.getState().wheelVelocity[1],1e-9);
+    EXPECT_EQ(4ul,odometry.getState().updates);
+}
+
+TEST(ColumnReader, RejectsAnIndexLargerThanTheFile) {
+    std::string path="mdc2250_tests_corrupt.mdct";
+    ColumnSet set;
+    set.values[column::_TIME].push_back(1000);
+    for (int c=1; c<column::COUNT; c++)
+        set.values[c].push_back(0);
+    ColumnWriter writer;
+    ASSERT_TRUE(writer.open(path));
+    ASSERT_TRUE(writer.write(set));
+    ASSERT_TRUE(writer.close());
+
+    // claim a huge block in the index entry
+    std::fstream file(path.c_str(),std::ios::in|std::ios::out|std::ios::binary);
+    boost::uint64_t indexOffset;
+    file.seekg(-16,std::ios::end);
+    file.read((char*)&indexOffset,sizeof(indexOffset));
+    boost::uint32_t length=0xffffffff;
+    file.seekp(indexOffset+offsetof(ColumnIndexEntry,length));
+    file.write((const char*)&length,sizeof(length));
+    file.close();
+
+    ColumnReader reader;
+    EXPECT_FALSE(reader.open(path));
+    EXPECT_TRUE(reader.isCorrupt());
+    std::remove(path.c_str());
+}
+
+namespace {
+
+void recordAs(const char *thread, const char *event) {
+    trace::setThreadName(thread);
+    trace::instant(event);
+}
+
+}
+
+TEST(Trace, ReusedRingKeepsTheRecordingThread) {
+    trace::enable(16);
+    trace::clear();
+    boost::thread first(boost::bind(&recordAs,"first","first_event"));
+    first.join();
+    boost::thread second(boost::bind(&recordAs,"second","second_event"));
+    second.join();
+    trace::disable();
+
+    // both events are in one ring but under different tids
+    std::string json=trace::toJson();
+    size_t firstEvent=json.find("\"first_event\"");
+    size_t secondEvent=json.find("\"second_event\"");
+    ASSERT_NE(std::string::npos,firstEvent);
+    ASSERT_NE(std::string::npos,secondEvent);
+    std::string tidKey="\"tid\":";
+    size_t firstTid=json.find(tidKey,firstEvent);
+    size_t secondTid=json.find(tidKey,secondEvent);
+    EXPECT_NE(json.substr(firstTid,json.find(',',firstTid)-firstTid),
+              json.substr(secondTid,json.find(',',secondTid)-secondTid));
+    EXPECT_NE(std::string::npos,json.find("\"name\":\"first\""));
+    EXPECT_NE(std::string::npos,json.find("\"name\":\"second\""));
+}